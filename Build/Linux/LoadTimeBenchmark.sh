@@ -0,0 +1,108 @@
+#!/bin/bash
+# Measures the load time of the gravity map in a packaged Linux build, headless.
+#
+#   LoadTimeBenchmark.sh [-runs N] [-record] <LinuxNoEditor directory>
+#
+# Every run starts the game with -nullrhi and -FPSLoadTimeExit, which quits on the first gameplay tick
+# after logging "LoadTime: ... to first gameplay tick". The cold runs drop the page cache first (root or vmtouch),
+# the warm runs go right after another run. Reports the in-game time from process start and the wall clock time.
+#
+# -record runs the game once with -fileopenlog and copies the file open order it writes to
+# Build/Linux/FileOpenOrder/GameOpenOrder.log, where the next package picks it up to order the pak and IoStore files.
+
+set -euo pipefail
+
+MAP=/Game/FirstPersonCPP/Maps/FirstPersonExampleMap
+RUNS=5
+RECORD=0
+SCRIPT_DIR="$(cd "$(dirname "$0")" && pwd)"
+
+while [ $# -gt 1 ]; do
+	case "$1" in
+		-runs) RUNS="$2"; shift 2 ;;
+		-record) RECORD=1; shift ;;
+		*) echo "Unknown option $1" >&2; exit 1 ;;
+	esac
+done
+
+if [ $# -ne 1 ] || [ ! -x "$1/FPSGameplay.sh" ]; then
+	echo "Usage: $0 [-runs N] [-record] <LinuxNoEditor directory with FPSGameplay.sh>" >&2
+	exit 1
+fi
+BUILD_DIR="$(cd "$1" && pwd)"
+LOG_DIR="$BUILD_DIR/FPSGameplay/Saved/Logs"
+
+drop_page_cache()
+{
+	sync
+	if [ -w /proc/sys/vm/drop_caches ]; then
+		echo 3 > /proc/sys/vm/drop_caches
+	elif sudo -n true 2>/dev/null; then
+		echo 3 | sudo -n tee /proc/sys/vm/drop_caches > /dev/null
+	elif command -v vmtouch > /dev/null; then
+		vmtouch -q -e "$BUILD_DIR"
+	else
+		echo "Cold runs need root, passwordless sudo or vmtouch to evict the build from the page cache" >&2
+		exit 1
+	fi
+}
+
+# Runs the game once, prints "<in-game seconds> <wall clock seconds>"
+run_game()
+{
+	local logName="LoadTimeBenchmark.log"
+	rm -f "$LOG_DIR/$logName"
+
+	local start end
+	start=$(date +%s.%N)
+	"$BUILD_DIR/FPSGameplay.sh" "$MAP" -nullrhi -nosound -nosplash -unattended -FPSLoadTimeExit -log="$logName" "$@" > /dev/null 2>&1
+	end=$(date +%s.%N)
+
+	local seconds
+	seconds=$(grep -o "to first gameplay tick [0-9.]*" "$LOG_DIR/$logName" | head -n 1 | awk '{ print $5 }')
+	if [ -z "$seconds" ]; then
+		echo "No LoadTime line in $LOG_DIR/$logName, the map didn't get to its first tick" >&2
+		exit 1
+	fi
+	echo "$seconds $(awk -v start="$start" -v end="$end" 'BEGIN { print end - start }')"
+}
+
+if [ $RECORD -eq 1 ]; then
+	drop_page_cache
+	run_game -fileopenlog > /dev/null
+	ORDER_LOG="$(find "$BUILD_DIR" -name GameOpenOrder.log -newer "$BUILD_DIR/FPSGameplay.sh" | head -n 1)"
+	if [ -z "$ORDER_LOG" ]; then
+		echo "The game didn't write a GameOpenOrder.log, -fileopenlog needs a non shipping build" >&2
+		exit 1
+	fi
+	mkdir -p "$SCRIPT_DIR/FileOpenOrder"
+	cp "$ORDER_LOG" "$SCRIPT_DIR/FileOpenOrder/GameOpenOrder.log"
+	echo "Recorded $(wc -l < "$ORDER_LOG") files to $SCRIPT_DIR/FileOpenOrder/GameOpenOrder.log, package again to use it"
+	exit 0
+fi
+
+# Prints the mean, median and min of the seconds read one per line
+stats()
+{
+	sort -n | awk '{ values[NR] = $1; sum += $1 } END { printf "%.3f s mean, %.3f s median, %.3f s min", sum / NR, values[int((NR + 1) / 2)], values[1] }'
+}
+
+report()
+{
+	local name="$1"
+	shift
+	echo "$name $# runs: first tick $(printf '%s\n' "$@" | cut -d' ' -f1 | stats); wall clock $(printf '%s\n' "$@" | cut -d' ' -f2 | stats)"
+}
+
+COLD=()
+WARM=()
+for ((i = 0; i < RUNS; i++)); do
+	drop_page_cache
+	result=$(run_game)
+	COLD+=("$result")
+	result=$(run_game)
+	WARM+=("$result")
+done
+
+report cold "${COLD[@]}"
+report warm "${WARM[@]}"
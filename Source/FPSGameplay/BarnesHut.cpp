@@ -0,0 +1,171 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BarnesHut.h"
+
+namespace GravityMath
+{
+	int32_t FBarnesHutTree::AddNode(const FVec3& Center, float HalfSize)
+	{
+		FNode node;
+		node.Center = Center;
+		node.HalfSize = HalfSize;
+		node.WeightedPosition = FVec3();
+		node.Mass = 0.f;
+		node.FirstChild = -1;
+		node.Body = -1;
+		node.Count = 0;
+		Nodes.push_back(node);
+		return (int32_t)Nodes.size() - 1;
+	}
+
+	int32_t FBarnesHutTree::GetOctant(const FNode& Node, const FVec3& Position) const
+	{
+		return (Position.X >= Node.Center.X ? 1 : 0) | (Position.Y >= Node.Center.Y ? 2 : 0) | (Position.Z >= Node.Center.Z ? 4 : 0);
+	}
+
+	void FBarnesHutTree::Subdivide(int32_t NodeIndex)
+	{
+		const FVec3 center = Nodes[NodeIndex].Center;
+		const float childHalfSize = Nodes[NodeIndex].HalfSize * 0.5f;
+
+		// children are added contiguously, AddNode can reallocate so don't keep references across it
+		int32_t firstChild = -1;
+		for (int32_t octant = 0; octant < 8; octant++)
+		{
+			const FVec3 offset((octant & 1) ? childHalfSize : -childHalfSize, (octant & 2) ? childHalfSize : -childHalfSize, (octant & 4) ? childHalfSize : -childHalfSize);
+			const int32_t child = AddNode(center + offset, childHalfSize);
+			firstChild = octant == 0 ? child : firstChild;
+		}
+		Nodes[NodeIndex].FirstChild = firstChild;
+	}
+
+	void FBarnesHutTree::Insert(int32_t Body)
+	{
+		const FVec3& position = Positions[Body];
+		const float mass = Masses[Body];
+
+		int32_t nodeIndex = 0;
+		for (int32_t depth = 0; ; depth++)
+		{
+			// every node on the way down gets the body in its center of mass
+			FNode& node = Nodes[nodeIndex];
+			node.WeightedPosition += position * mass;
+			node.Mass += mass;
+			node.Count++;
+
+			if (node.Count == 1)
+			{
+				node.Body = Body;
+				return;
+			}
+
+			if (node.FirstChild < 0)
+			{
+				if (depth >= MaxDepth)
+				{
+					// merged leaf, the bodies only contribute to the center of mass
+					node.Body = -1;
+					return;
+				}
+
+				// push the body that was alone in this leaf one level down
+				const int32_t previousBody = node.Body;
+				Subdivide(nodeIndex);
+				FNode& parent = Nodes[nodeIndex];
+				parent.Body = -1;
+				FNode& child = Nodes[parent.FirstChild + GetOctant(parent, Positions[previousBody])];
+				child.WeightedPosition = Positions[previousBody] * Masses[previousBody];
+				child.Mass = Masses[previousBody];
+				child.Count = 1;
+				child.Body = previousBody;
+			}
+
+			const FNode& parent = Nodes[nodeIndex];
+			nodeIndex = parent.FirstChild + GetOctant(parent, position);
+		}
+	}
+
+	void FBarnesHutTree::Build(const FVec3* InPositions, const float* InMasses, int32_t Count)
+	{
+		Positions = InPositions;
+		Masses = InMasses;
+		NumBodies = Count;
+		Nodes.clear();
+
+		if (Count <= 0)
+		{
+			return;
+		}
+
+		// root cube around all the bodies
+		FVec3 minBounds = Positions[0];
+		FVec3 maxBounds = Positions[0];
+		for (int32_t i = 1; i < Count; i++)
+		{
+			minBounds = FVec3(std::fmin(minBounds.X, Positions[i].X), std::fmin(minBounds.Y, Positions[i].Y), std::fmin(minBounds.Z, Positions[i].Z));
+			maxBounds = FVec3(std::fmax(maxBounds.X, Positions[i].X), std::fmax(maxBounds.Y, Positions[i].Y), std::fmax(maxBounds.Z, Positions[i].Z));
+		}
+		const FVec3 extent = (maxBounds - minBounds) * 0.5f;
+		const float halfSize = std::fmax(std::fmax(extent.X, extent.Y), std::fmax(extent.Z, 1.f));
+
+		Nodes.reserve(Count * 2);
+		AddNode((minBounds + maxBounds) * 0.5f, halfSize);
+
+		for (int32_t i = 0; i < Count; i++)
+		{
+			Insert(i);
+		}
+	}
+
+	void FBarnesHutTree::AccumulateForces(float GravityConstant, float OpeningAngle, float Softening, FVec3* OutForces) const
+	{
+		if (Nodes.empty())
+		{
+			return;
+		}
+
+		const float openingAngleSquared = OpeningAngle * OpeningAngle;
+		const float softeningSquared = Softening * Softening;
+
+		for (int32_t body = 0; body < NumBodies; body++)
+		{
+			const FVec3 position = Positions[body];
+			FVec3 acceleration;
+
+			Stack.clear();
+			Stack.push_back(0);
+			while (!Stack.empty())
+			{
+				const FNode& node = Nodes[Stack.back()];
+				Stack.pop_back();
+
+				if (node.Count == 0 || node.Body == body || node.Mass <= 0.f)
+				{
+					continue;
+				}
+
+				const FVec3 centerOfMass = node.WeightedPosition * (1.f / node.Mass);
+				const FVec3 offset = centerOfMass - position;
+				const float distanceSquared = SizeSquared(offset) + softeningSquared;
+				const float size = node.HalfSize * 2.f;
+
+				// leaves and far enough nodes are approximated by their center of mass, the rest are opened
+				if (node.FirstChild < 0 || size * size < openingAngleSquared * distanceSquared)
+				{
+					const float inverseDistance = 1.f / std::sqrt(distanceSquared);
+					acceleration += offset * (node.Mass * inverseDistance * inverseDistance * inverseDistance);
+				}
+				else
+				{
+					for (int32_t child = 0; child < 8; child++)
+					{
+						Stack.push_back(node.FirstChild + child);
+					}
+				}
+			}
+
+			OutForces[body] += acceleration * (GravityConstant * Masses[body]);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Engine independent Barnes-Hut octree used for the mutual attraction between the bodies of a gravity field.
+ * Like GravityMath.h it only depends on the C++ standard library.
+ */
+
+#include "GravityMath.h"
+#include <vector>
+
+namespace GravityMath
+{
+	class FBarnesHutTree
+	{
+	public:
+		/** Rebuilds the tree from scratch. The arrays must stay alive until the accelerations are computed */
+		void Build(const FVec3* Positions, const float* Masses, int32_t Count);
+
+		/**
+		 * Adds the mutual attraction of every body to OutForces (Count elements, one per body given to Build).
+		 * @param GravityConstant	strength of the attraction
+		 * @param OpeningAngle		theta: a node is approximated by its center of mass when size / distance is below it. 0 is the exact O(n^2) sum
+		 * @param Softening			keeps the force finite when two bodies get very close
+		 */
+		void AccumulateForces(float GravityConstant, float OpeningAngle, float Softening, FVec3* OutForces) const;
+
+		/** Number of nodes of the last built tree */
+		int32_t GetNumNodes() const { return (int32_t)Nodes.size(); }
+
+	private:
+		struct FNode
+		{
+			FVec3 Center;
+			float HalfSize;
+			FVec3 WeightedPosition;
+			float Mass;
+			int32_t FirstChild;
+			int32_t Body;
+			int32_t Count;
+		};
+
+		/** Deeper than this the bodies are merged in the same leaf, protects against bodies in the same spot */
+		static const int32_t MaxDepth = 20;
+
+		int32_t AddNode(const FVec3& Center, float HalfSize);
+		void Subdivide(int32_t NodeIndex);
+		int32_t GetOctant(const FNode& Node, const FVec3& Position) const;
+		void Insert(int32_t Body);
+
+		std::vector<FNode> Nodes;
+		mutable std::vector<int32_t> Stack;
+		const FVec3* Positions = nullptr;
+		const float* Masses = nullptr;
+		int32_t NumBodies = 0;
+	};
+}
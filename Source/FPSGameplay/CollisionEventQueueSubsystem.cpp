@@ -0,0 +1,286 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "CollisionEventQueueSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SphereComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPSGameplayMemory.h"
+
+static FAutoConsoleCommandWithWorld CollisionStatsCommand(
+	TEXT("fps.Collision.Stats"),
+	TEXT("Logs the collision queue counters since the last call: events per frame and handler type, dropped events and dispatch time"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UCollisionEventQueueSubsystem* collisionQueue = World->GetSubsystem<UCollisionEventQueueSubsystem>())
+		{
+			collisionQueue->ReportStats();
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs CollisionBenchmarkCommand(
+	TEXT("fps.Collision.BenchmarkEnqueue"),
+	TEXT("fps.Collision.BenchmarkEnqueue [count]: logs the time to queue an overlap through the dynamic delegate and through a native call"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UCollisionEventQueueSubsystem* collisionQueue = World->GetSubsystem<UCollisionEventQueueSubsystem>())
+		{
+			collisionQueue->BenchmarkEnqueue(Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 100000);
+		}
+	}));
+
+/** Handlers can queue new events (a destroyed projectile ends its overlaps), they're dispatched in up to this many rounds per frame */
+static const int32 MaxDispatchRounds = 4;
+
+void FCollisionQueueTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->DispatchEvents();
+	}
+}
+
+FString FCollisionQueueTickFunction::DiagnosticMessage()
+{
+	return TEXT("FCollisionQueueTickFunction");
+}
+
+void UCollisionEventQueueSubsystem::Deinitialize()
+{
+	if (QueueTickFunction.IsTickFunctionRegistered())
+	{
+		QueueTickFunction.UnRegisterTickFunction();
+	}
+	Registrations.Reset();
+	PendingRemovals.Reset();
+	for (TArray<FCollisionQueueEvent>& queue : Queues)
+	{
+		queue.Reset();
+	}
+
+	Super::Deinitialize();
+}
+
+void UCollisionEventQueueSubsystem::RegisterComponent(UPrimitiveComponent* Component, ECollisionHandlerType Type, FCollisionEventHandler Handler)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	if (!Component)
+	{
+		return;
+	}
+
+	// the tick function is registered with the first component, the level is guaranteed to exist by then
+	if (!QueueTickFunction.IsTickFunctionRegistered())
+	{
+		QueueTickFunction.Owner = this;
+		QueueTickFunction.bCanEverTick = true;
+		QueueTickFunction.TickGroup = TG_PostPhysics;
+		QueueTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	// a registration waiting for removal can be taken back, but its handler may be running so it's kept as is
+	if (FRegistration* registration = Registrations.Find(Component))
+	{
+		if (bDispatching)
+		{
+			registration->bActive = true;
+			return;
+		}
+	}
+
+	FRegistration& registration = Registrations.Add(Component);
+	registration.Type = Type;
+	registration.Handler = MoveTemp(Handler);
+	registration.bActive = true;
+
+	Component->OnComponentBeginOverlap.AddUniqueDynamic(this, &UCollisionEventQueueSubsystem::QueueBeginOverlap);
+	Component->OnComponentEndOverlap.AddUniqueDynamic(this, &UCollisionEventQueueSubsystem::QueueEndOverlap);
+}
+
+void UCollisionEventQueueSubsystem::UnregisterComponent(UPrimitiveComponent* Component)
+{
+	FRegistration* registration = Registrations.Find(Component);
+	if (!registration)
+	{
+		return;
+	}
+
+	Component->OnComponentBeginOverlap.RemoveDynamic(this, &UCollisionEventQueueSubsystem::QueueBeginOverlap);
+	Component->OnComponentEndOverlap.RemoveDynamic(this, &UCollisionEventQueueSubsystem::QueueEndOverlap);
+
+	if (bDispatching)
+	{
+		registration->bActive = false;
+		PendingRemovals.Add(Component);
+	}
+	else
+	{
+		Registrations.Remove(Component);
+	}
+}
+
+FCollisionQueueEvent* UCollisionEventQueueSubsystem::AddEvent(ECollisionEventKind Kind, UPrimitiveComponent* Component, AActor* OtherActor, UPrimitiveComponent* OtherComp)
+{
+	const FRegistration* registration = Registrations.Find(Component);
+	if (!registration || !registration->bActive)
+	{
+		return nullptr;
+	}
+
+	FCollisionQueueEvent& event = Queues[(int32)registration->Type].AddDefaulted_GetRef();
+	event.Kind = Kind;
+	event.Component = Component;
+	event.OtherActor = OtherActor;
+	event.OtherComponent = OtherComp;
+	return &event;
+}
+
+void UCollisionEventQueueSubsystem::QueueHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, const FVector& NormalImpulse, const FHitResult& Hit, const FVector& Velocity)
+{
+	if (FCollisionQueueEvent* event = AddEvent(ECollisionEventKind::Hit, HitComp, OtherActor, OtherComp))
+	{
+		event->NormalImpulse = NormalImpulse;
+		event->Hit = Hit;
+		event->Velocity = Velocity;
+	}
+}
+
+void UCollisionEventQueueSubsystem::QueueBeginOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	if (FCollisionQueueEvent* event = AddEvent(ECollisionEventKind::BeginOverlap, OverlappedComp, OtherActor, OtherComp))
+	{
+		event->OtherBodyIndex = OtherBodyIndex;
+		event->bFromSweep = bFromSweep;
+		event->Hit = SweepResult;
+	}
+}
+
+void UCollisionEventQueueSubsystem::QueueEndOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	if (FCollisionQueueEvent* event = AddEvent(ECollisionEventKind::EndOverlap, OverlappedComp, OtherActor, OtherComp))
+	{
+		event->OtherBodyIndex = OtherBodyIndex;
+	}
+}
+
+void UCollisionEventQueueSubsystem::DispatchEvents()
+{
+	const double startTime = FPlatformTime::Seconds();
+	int32 numFrameEvents = 0;
+
+	bDispatching = true;
+	for (int32 round = 0; round < MaxDispatchRounds; round++)
+	{
+		bool bAnyEvents = false;
+		for (int32 type = 0; type < (int32)ECollisionHandlerType::Count; type++)
+		{
+			if (Queues[type].Num() == 0)
+			{
+				continue;
+			}
+			bAnyEvents = true;
+
+			// events queued by the handlers go to the emptied queue and wait for the next round
+			Swap(DispatchBuffer, Queues[type]);
+			for (const FCollisionQueueEvent& event : DispatchBuffer)
+			{
+				const FRegistration* registration = Registrations.Find(event.GetComponent());
+				if (!registration || !registration->bActive)
+				{
+					NumDropped++;
+					continue;
+				}
+
+				registration->Handler.ExecuteIfBound(event);
+				NumEvents[type]++;
+				numFrameEvents++;
+			}
+			DispatchBuffer.Reset();
+		}
+
+		if (!bAnyEvents)
+		{
+			break;
+		}
+	}
+	bDispatching = false;
+
+	for (const UPrimitiveComponent* component : PendingRemovals)
+	{
+		const FRegistration* registration = Registrations.Find(component);
+		if (registration && !registration->bActive)
+		{
+			Registrations.Remove(component);
+		}
+	}
+	PendingRemovals.Reset();
+
+	const double seconds = FPlatformTime::Seconds() - startTime;
+	NumFrames++;
+	MaxEventsPerFrame = FMath::Max(MaxEventsPerFrame, numFrameEvents);
+	DispatchSeconds += seconds;
+	MaxDispatchSeconds = FMath::Max(MaxDispatchSeconds, seconds);
+}
+
+void UCollisionEventQueueSubsystem::BenchmarkEnqueue(int32 Count)
+{
+	if (bDispatching || Count <= 0)
+	{
+		return;
+	}
+
+	// a component of its own, registered for the measurement only. Its events are taken back out of the queue
+	USphereComponent* component = NewObject<USphereComponent>(this);
+	RegisterComponent(component, ECollisionHandlerType::GravityOverlap, FCollisionEventHandler());
+
+	TArray<FCollisionQueueEvent>& queue = Queues[(int32)ECollisionHandlerType::GravityOverlap];
+	const int32 numQueued = queue.Num();
+	queue.Reserve(numQueued + Count);
+	const FHitResult sweepResult;
+
+	double startTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; i++)
+	{
+		component->OnComponentBeginOverlap.Broadcast(component, nullptr, nullptr, 0, false, sweepResult);
+	}
+	const double dynamicSeconds = FPlatformTime::Seconds() - startTime;
+	queue.SetNum(numQueued, false);
+
+	startTime = FPlatformTime::Seconds();
+	for (int32 i = 0; i < Count; i++)
+	{
+		QueueBeginOverlap(component, nullptr, nullptr, 0, false, sweepResult);
+	}
+	const double nativeSeconds = FPlatformTime::Seconds() - startTime;
+	queue.SetNum(numQueued, false);
+
+	UnregisterComponent(component);
+
+	UE_LOG(LogTemp, Display, TEXT("Collision queue: %d overlaps queued in %.1f ns each through the dynamic delegate, %.1f ns each with a native call"),
+		Count, dynamicSeconds * 1e9 / Count, nativeSeconds * 1e9 / Count);
+}
+
+void UCollisionEventQueueSubsystem::ReportStats()
+{
+	int64 numEvents = 0;
+	for (int64 count : NumEvents)
+	{
+		numEvents += count;
+	}
+	UE_LOG(LogTemp, Display, TEXT("Collision queue: %d registered components. Over %d frames: %.1f events per frame (peak %d), %lld projectile hits, %lld gravity overlaps, %d dropped, %.3f ms dispatch per frame (peak %.3f ms)"),
+		Registrations.Num(), NumFrames, NumFrames > 0 ? (float)numEvents / NumFrames : 0.f, MaxEventsPerFrame,
+		NumEvents[(int32)ECollisionHandlerType::ProjectileHit], NumEvents[(int32)ECollisionHandlerType::GravityOverlap], NumDropped,
+		NumFrames > 0 ? DispatchSeconds * 1000.0 / NumFrames : 0.0, MaxDispatchSeconds * 1000.0);
+
+	NumFrames = 0;
+	for (int64& count : NumEvents)
+	{
+		count = 0;
+	}
+	MaxEventsPerFrame = 0;
+	NumDropped = 0;
+	DispatchSeconds = 0.0;
+	MaxDispatchSeconds = 0.0;
+}
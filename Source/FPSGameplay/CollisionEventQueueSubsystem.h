@@ -0,0 +1,133 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Engine/EngineTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "CollisionEventQueueSubsystem.generated.h"
+
+class UCollisionEventQueueSubsystem;
+class UPrimitiveComponent;
+
+/** Collision event a component received */
+enum class ECollisionEventKind : uint8
+{
+	Hit,
+	BeginOverlap,
+	EndOverlap
+};
+
+/** Kinds of handlers registered in the queue. The events are dispatched grouped by handler type, in this order */
+enum class ECollisionHandlerType : uint8
+{
+	ProjectileHit,
+	GravityOverlap,
+
+	Count
+};
+
+/** A queued hit or overlap, with the same data the component's event had */
+struct FCollisionQueueEvent
+{
+	ECollisionEventKind Kind;
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	TWeakObjectPtr<AActor> OtherActor;
+	TWeakObjectPtr<UPrimitiveComponent> OtherComponent;
+	FVector NormalImpulse;
+	FHitResult Hit;
+	/** Velocity of Component when it hit, before the hit response changed it */
+	FVector Velocity;
+	int32 OtherBodyIndex;
+	bool bFromSweep;
+
+	/** Objects destroyed after the event are still returned until they're garbage collected, so the handlers can clean up after them */
+	UPrimitiveComponent* GetComponent() const { return Component.Get(true); }
+	AActor* GetOtherActor() const { return OtherActor.Get(true); }
+	UPrimitiveComponent* GetOtherComponent() const { return OtherComponent.Get(true); }
+};
+
+DECLARE_DELEGATE_OneParam(FCollisionEventHandler, const FCollisionQueueEvent&);
+
+/** Tick function that dispatches the events of the frame after physics */
+struct FCollisionQueueTickFunction : public FTickFunction
+{
+	UCollisionEventQueueSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Buffers the hit and overlap events of the registered components and hands them to native handlers once per frame,
+ * after physics, grouped by handler type. The gameplay handlers don't go through reflection and run back to back.
+ * Hits come in natively, forwarded by the owner's NotifyHit. The engine has no native overlap notification per component
+ * (NotifyActorBeginOverlap is per actor pair), so the overlaps still come in through the component's dynamic delegates.
+ * fps.Collision.Stats reports the events per frame and the dispatch time, fps.Collision.BenchmarkEnqueue the cost of
+ * the dynamic binding against a native call.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UCollisionEventQueueSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Queues the hits and overlaps of Component for Handler. A component has one handler. Its hits have to be forwarded with QueueHit */
+	void RegisterComponent(UPrimitiveComponent* Component, ECollisionHandlerType Type, FCollisionEventHandler Handler);
+
+	/** Queues a hit of a registered component, called from the owner's NotifyHit. Hits of other components are ignored */
+	void QueueHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, const FVector& NormalImpulse, const FHitResult& Hit, const FVector& Velocity);
+
+	/** Stops queuing the events of Component and drops the ones already queued */
+	void UnregisterComponent(UPrimitiveComponent* Component);
+
+	/** Runs the handlers of the queued events, including the ones the handlers queue themselves */
+	void DispatchEvents();
+
+	/** Logs the counters since the last report and resets them */
+	void ReportStats();
+
+	/** Logs the time to queue Count overlaps through the dynamic delegate and through a native call */
+	void BenchmarkEnqueue(int32 Count);
+
+private:
+	UFUNCTION()
+		void QueueBeginOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	UFUNCTION()
+		void QueueEndOverlap(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
+	/** Adds an event for a registered component to the queue of its handler type, null if it isn't registered */
+	FCollisionQueueEvent* AddEvent(ECollisionEventKind Kind, UPrimitiveComponent* Component, AActor* OtherActor, UPrimitiveComponent* OtherComp);
+
+	struct FRegistration
+	{
+		ECollisionHandlerType Type;
+		FCollisionEventHandler Handler;
+
+		/** False once unregistered during a dispatch, it's removed when the dispatch ends */
+		bool bActive;
+	};
+
+	/** Handler of every registered component. Nothing is removed during a dispatch, so a running handler is never destroyed */
+	TMap<const UPrimitiveComponent*, FRegistration> Registrations;
+	TArray<const UPrimitiveComponent*> PendingRemovals;
+	bool bDispatching = false;
+
+	/** Events waiting for dispatch, one queue per handler type. The dispatch swaps them with DispatchBuffer so both keep their memory */
+	TArray<FCollisionQueueEvent> Queues[(int32)ECollisionHandlerType::Count];
+	TArray<FCollisionQueueEvent> DispatchBuffer;
+
+	FCollisionQueueTickFunction QueueTickFunction;
+
+	/** Counters since the last report */
+	int32 NumFrames = 0;
+	int64 NumEvents[(int32)ECollisionHandlerType::Count] = {};
+	int32 MaxEventsPerFrame = 0;
+	int32 NumDropped = 0;
+	double DispatchSeconds = 0.0;
+	double MaxDispatchSeconds = 0.0;
+};
@@ -8,8 +8,29 @@ public class FPSGameplay : ModuleRules
 	{
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
-		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay" });
+		// The dedicated server only runs the gameplay: no VR, HUD, sounds, animations or touch input
+		bool bHeadless = Target.Type == TargetType.Server;
+
+		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "AIModule" });
         PrivateDependencyModuleNames.AddRange(new string[] { "CableComponent" });
         PrivateIncludePathModuleNames.AddRange(new string[] { "CableComponent" });
+
+		if (!bHeadless)
+		{
+			PublicDependencyModuleNames.Add("HeadMountedDisplay");
+		}
+
+		// Chaos builds can run the gravity of the bodies inside the physics solver as a field
+		bool bChaosFields = Target.bUseChaos;
+		if (bChaosFields)
+		{
+			PrivateDependencyModuleNames.AddRange(new string[] { "Chaos", "FieldSystemEngine" });
+		}
+
+		PublicDefinitions.Add("WITH_FPS_VR=" + (bHeadless ? "0" : "1"));
+		PublicDefinitions.Add("WITH_FPS_HUD=" + (bHeadless ? "0" : "1"));
+		PublicDefinitions.Add("WITH_FPS_COSMETICS=" + (bHeadless ? "0" : "1"));
+		PublicDefinitions.Add("WITH_FPS_TOUCH=" + (bHeadless ? "0" : "1"));
+		PublicDefinitions.Add("WITH_FPS_CHAOS_FIELDS=" + (bChaosFields ? "1" : "0"));
     }
 }
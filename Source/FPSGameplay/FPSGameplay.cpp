@@ -2,6 +2,22 @@
 
 #include "FPSGameplay.h"
 #include "Modules/ModuleManager.h"
+#include "FPSGameplayMemory.h"
+#include "FPSGameplayLoadTime.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, FPSGameplay, "FPSGameplay" );
- 
\ No newline at end of file
+class FFPSGameplayModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		FPSGameplayMemory::RegisterLLMTags();
+		FPSGameplayLoadTime::Register();
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FPSGameplayMemory::UnregisterLLMTags();
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FFPSGameplayModule, FPSGameplay, "FPSGameplay" );
@@ -7,23 +7,66 @@
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
 #include "GameFramework/InputSettings.h"
-#include "HeadMountedDisplayFunctionLibrary.h"
 #include "Kismet/GameplayStatics.h"
-#include "MotionControllerComponent.h"
 #include "Math/Vector.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#if WITH_FPS_VR
+#include "HeadMountedDisplayFunctionLibrary.h"
+#include "MotionControllerComponent.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
+#endif
+#include "HookAnchorSubsystem.h"
+#include "Components/SphereComponent.h"
+#include "EngineUtils.h"
+#include "GravityGunTickSubsystem.h"
+#include "TimingWheelSubsystem.h"
+#include "FPSGameplayMemory.h"
+#include "GravityGunMovementComponent.h"
+#include "GameplayAudioSubsystem.h"
+#include "HookRopeComponent.h"
+#include "Engine/SkeletalMesh.h"
+#include "UObject/ConstructorHelpers.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
 
+/** Logs the components of every character with their registration state and memory, to compare builds and net modes */
+static FAutoConsoleCommandWithWorld ReportCharacterComponentsCommand(
+	TEXT("fps.Character.ReportComponents"),
+	TEXT("Logs the number of components, registered components and component memory of every FPS character"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TActorIterator<AFPSGameplayCharacter> it(World); it; ++it)
+		{
+			TInlineComponentArray<UActorComponent*> components(*it);
+			int32 numRegistered = 0;
+			int32 numSceneComponents = 0;
+			SIZE_T componentBytes = 0;
+			for (UActorComponent* component : components)
+			{
+				numRegistered += component->IsRegistered() ? 1 : 0;
+				numSceneComponents += component->IsA<USceneComponent>() ? 1 : 0;
+				componentBytes += component->GetClass()->GetStructureSize() + component->GetResourceSizeBytes(EResourceSizeMode::Exclusive);
+			}
+			UE_LOG(LogTemp, Display, TEXT("%s: %d components (%d registered, %d scene components with transform updates), %llu bytes"),
+				*it->GetName(), components.Num(), numRegistered, numSceneComponents, (uint64)componentBytes);
+		}
+	}));
+
 //////////////////////////////////////////////////////////////////////////
 // AFPSGameplayCharacter
 
-AFPSGameplayCharacter::AFPSGameplayCharacter()
+AFPSGameplayCharacter::AFPSGameplayCharacter(const FObjectInitializer& ObjectInitializer)
+	: Super(ObjectInitializer.SetDefaultSubobjectClass<UGravityGunMovementComponent>(ACharacter::CharacterMovementComponentName))
 {
+	FPS_LLM_SCOPE(CharacterGameplay);
+
 	// Set size for collision capsule
 	GetCapsuleComponent()->InitCapsuleSize(55.f, 96.0f);
 
+	// the gravity gun logic is ticked by UGravityGunTickSubsystem for all the characters at once. A blueprint subclass
+	// that implements Event Tick still ticks, the blueprint compiler turns bCanEverTick back on for it
+	PrimaryActorTick.bCanEverTick = false;
+
 	// set our turn rates for input
 	BaseTurnRate = 45.f;
 	BaseLookUpRate = 45.f;
@@ -63,39 +106,86 @@ AFPSGameplayCharacter::AFPSGameplayCharacter()
 	FP_MuzzleLocationHook->SetupAttachment(FP_Gun);
 	FP_MuzzleLocationHook->SetRelativeLocation(FVector(0.2f, 58.4f, 9.4));
 
-	HookRope = CreateDefaultSubobject<UCableComponent>(TEXT("GravityHookConnection"));
-	HookRope->SetVisibility(false);
-	
-
 	// Default offset from the character location for projectiles to spawn
 	GunOffset = FVector(100.0f, 0.0f, 10.0f);
 
-	// Note: The ProjectileClass and the skeletal mesh/anim blueprints for Mesh1P, FP_Gun, and VR_Gun 
+	// Note: The ProjectileClass and the skeletal mesh/anim blueprints for Mesh1P and FP_Gun 
 	// are set in the derived blueprint asset named MyCharacter to avoid direct content references in C++.
 
+	// The VR controllers, the VR gun and the hook rope are not default subobjects: most characters never use them,
+	// and none of them are needed on a dedicated server. See CreateMotionControllerComponents and GetHookRope.
+	// Their defaults are the ones FirstPersonCharacter_BP used to set on the old subobjects
+	static ConstructorHelpers::FObjectFinder<USkeletalMesh> VRGunMeshObj(TEXT("/Game/FirstPerson/FPWeapon/Mesh/SK_FPGun"));
+	VRGunMesh = VRGunMeshObj.Object;
+	static ConstructorHelpers::FObjectFinder<UMaterialInterface> HookRopeMaterialObj(TEXT("/Game/FirstPerson/Materials/GravityAreaMaterial_Hook"));
+	HookRopeMaterial = HookRopeMaterialObj.Object;
+
+	// Uncomment the following line to turn motion controllers on by default:
+	//bUsingMotionControllers = true;
+}
+
+void AFPSGameplayCharacter::CreateMotionControllerComponents()
+{
+	FPS_LLM_SCOPE(CharacterGameplay);
+
+#if WITH_FPS_VR
 	// Create VR Controllers.
-	R_MotionController = CreateDefaultSubobject<UMotionControllerComponent>(TEXT("R_MotionController"));
-	R_MotionController->MotionSource = FXRMotionControllerBase::RightHandSourceId;
-	R_MotionController->SetupAttachment(RootComponent);
-	L_MotionController = CreateDefaultSubobject<UMotionControllerComponent>(TEXT("L_MotionController"));
+	UMotionControllerComponent* rightController = NewObject<UMotionControllerComponent>(this, TEXT("R_MotionController"));
+	rightController->MotionSource = FXRMotionControllerBase::RightHandSourceId;
+	rightController->SetupAttachment(RootComponent);
+	R_MotionController = rightController;
+	L_MotionController = NewObject<UMotionControllerComponent>(this, TEXT("L_MotionController"));
 	L_MotionController->SetupAttachment(RootComponent);
 
 	// Create a gun and attach it to the right-hand VR controller.
-	// Create a gun mesh component
-	VR_Gun = CreateDefaultSubobject<USkeletalMeshComponent>(TEXT("VR_Gun"));
+	VR_Gun = NewObject<USkeletalMeshComponent>(this, TEXT("VR_Gun"));
+	VR_Gun->SetSkeletalMesh(VRGunMesh);
 	VR_Gun->SetOnlyOwnerSee(true);			// only the owning player will see this mesh
 	VR_Gun->bCastDynamicShadow = false;
 	VR_Gun->CastShadow = false;
 	VR_Gun->SetupAttachment(R_MotionController);
 	VR_Gun->SetRelativeRotation(FRotator(0.0f, -90.0f, 0.0f));
 
-	VR_MuzzleLocation = CreateDefaultSubobject<USceneComponent>(TEXT("VR_MuzzleLocation"));
+	VR_MuzzleLocation = NewObject<USceneComponent>(this, TEXT("VR_MuzzleLocation"));
 	VR_MuzzleLocation->SetupAttachment(VR_Gun);
 	VR_MuzzleLocation->SetRelativeLocation(FVector(0.000004, 53.999992, 10.000000));
 	VR_MuzzleLocation->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));		// Counteract the rotation of the VR gun model.
 
-	// Uncomment the following line to turn motion controllers on by default:
-	//bUsingMotionControllers = true;
+	R_MotionController->RegisterComponent();
+	L_MotionController->RegisterComponent();
+	VR_Gun->RegisterComponent();
+	VR_MuzzleLocation->RegisterComponent();
+#endif
+}
+
+UCableComponent* AFPSGameplayCharacter::GetHookRope()
+{
+	FPS_LLM_SCOPE(CharacterGameplay);
+
+#if WITH_FPS_COSMETICS
+	if (!HookRope && !IsNetMode(NM_DedicatedServer))
+	{
+		HookRope = NewObject<UHookRopeComponent>(this, TEXT("GravityHookConnection"));
+		HookRope->CableWidth = HookRopeWidth;
+		HookRope->NumSegments = 20;
+		HookRope->NumSides = 10;
+		HookRope->SolverIterations = 16;
+		HookRope->bEnableStiffness = true;
+		HookRope->CableGravityScale = 1.2f;
+		if (HookRopeMaterial)
+		{
+			HookRope->SetMaterial(0, HookRopeMaterial);
+		}
+		// the start stays on the anchor in world space while the capsule moves, the end follows the hook muzzle
+		HookRope->SetupAttachment(RootComponent);
+		HookRope->SetUsingAbsoluteLocation(true);
+		HookRope->SetUsingAbsoluteRotation(true);
+		HookRope->SetAttachEndTo(this, GET_MEMBER_NAME_CHECKED(AFPSGameplayCharacter, FP_MuzzleLocationHook));
+		HookRope->SetVisibility(false);
+		HookRope->RegisterComponent();
+	}
+#endif
+	return HookRope;
 }
 
 void AFPSGameplayCharacter::BeginPlay()
@@ -103,25 +193,40 @@ void AFPSGameplayCharacter::BeginPlay()
 	// Call the base class  
 	Super::BeginPlay();
 
-	GameHud = Cast<AFPSGameplayHUD>(GetWorld()->GetFirstPlayerController()->GetHUD());
+#if WITH_FPS_HUD
+	// there is no player controller (and no HUD) on a dedicated server
+	if (APlayerController* playerController = GetWorld()->GetFirstPlayerController())
+	{
+		GameHud = Cast<AFPSGameplayHUD>(playerController->GetHUD());
+	}
+#endif
 	//Attach gun mesh component to Skeleton, doing it here because the skeleton is not yet created in the constructor
 	FP_Gun->AttachToComponent(Mesh1P, FAttachmentTransformRules(EAttachmentRule::SnapToTarget, true), TEXT("GripPoint"));
 
 	// Show or hide the two versions of the gun based on whether or not we're using motion controllers.
-	if (bUsingMotionControllers)
+	if (IsNetMode(NM_DedicatedServer))
+	{
+		// nobody sees the first person meshes on a dedicated server, only keep them for the muzzle locations
+		Mesh1P->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+		FP_Gun->VisibilityBasedAnimTickOption = EVisibilityBasedAnimTickOption::OnlyTickPoseWhenRendered;
+		Mesh1P->SetComponentTickEnabled(false);
+		FP_Gun->SetComponentTickEnabled(false);
+	}
+	else if (bUsingMotionControllers)
 	{
-		VR_Gun->SetHiddenInGame(false, true);
+		CreateMotionControllerComponents();
 		Mesh1P->SetHiddenInGame(true, true);
 	}
 	else
 	{
-		VR_Gun->SetHiddenInGame(true, true);
 		Mesh1P->SetHiddenInGame(false, true);
 	}
 
 	//Spawn the gravity ball
 	if (GravityBallClass != NULL)
 	{
+		FPS_LLM_SCOPE(GravitySystem);
+
 		UWorld* const World = GetWorld();
 		if (World != NULL)
 		{
@@ -146,6 +251,34 @@ void AFPSGameplayCharacter::BeginPlay()
 	{
 		UE_LOG(LogTemp, Warning, TEXT("The gravity ball subclass is not selected!"));
 	}
+
+	if (UGravityGunTickSubsystem* gravityGunTick = GetWorld()->GetSubsystem<UGravityGunTickSubsystem>())
+	{
+		gravityGunTick->RegisterCharacter(this);
+	}
+}
+
+void AFPSGameplayCharacter::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UGravityGunTickSubsystem* gravityGunTick = GetWorld()->GetSubsystem<UGravityGunTickSubsystem>())
+	{
+		gravityGunTick->UnregisterCharacter(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FGravityGunCharacterState* AFPSGameplayCharacter::GetGravityGunState() const
+{
+	UGravityGunTickSubsystem* gravityGunTick = GetWorld()->GetSubsystem<UGravityGunTickSubsystem>();
+	return gravityGunTick ? gravityGunTick->FindState(this) : nullptr;
+}
+
+float AFPSGameplayCharacter::GetGravityBallTimeRemaining() const
+{
+	const FGravityGunCharacterState* state = GetGravityGunState();
+	const UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+	return state && timingWheel ? timingWheel->GetTimeRemaining(state->BallTimeoutHandle) : 0.f;
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -172,10 +305,14 @@ void AFPSGameplayCharacter::SetupPlayerInputComponent(class UInputComponent* Pla
 	PlayerInputComponent->BindAction("GravityMode2", IE_Pressed, this, &AFPSGameplayCharacter::OnSetGravityModeRepulsion);
 	PlayerInputComponent->BindAction("GravityMode3", IE_Pressed, this, &AFPSGameplayCharacter::OnSetGravityModeHook);
 
+#if WITH_FPS_TOUCH
 	// Enable touchscreen input
 	EnableTouchscreenMovement(PlayerInputComponent);
+#endif
 
+#if WITH_FPS_VR
 	PlayerInputComponent->BindAction("ResetVR", IE_Pressed, this, &AFPSGameplayCharacter::OnResetVR);
+#endif
 
 	// Bind movement events
 	PlayerInputComponent->BindAxis("MoveForward", this, &AFPSGameplayCharacter::MoveForward);
@@ -190,37 +327,61 @@ void AFPSGameplayCharacter::SetupPlayerInputComponent(class UInputComponent* Pla
 	PlayerInputComponent->BindAxis("LookUpRate", this, &AFPSGameplayCharacter::LookUpAtRate);
 }
 
-void AFPSGameplayCharacter::Tick(float DeltaTime)
+void AFPSGameplayCharacter::InitializeBotInput()
 {
-	Super::Tick(DeltaTime);
-
-	//handle the swing
-	if (GravityBall->GravityMode == E_GravityMode::MODE_HOOK && IsSwinging && GetCharacterMovement()->IsFalling() && GravityBall->IsGravityActive)
+	if (!InputComponent)
 	{
-		HangFromGravityHook();
+		InputComponent = CreatePlayerInputComponent();
+		SetupPlayerInputComponent(InputComponent);
 	}
+}
 
-	//handle the timer
-	if (GravityBallTimer > 0)
+void AFPSGameplayCharacter::InjectInputAction(FName ActionName, EInputEvent KeyEvent)
+{
+	if (!InputComponent)
 	{
-		GravityBallTimer -= DeltaTime;
+		return;
 	}
-	else if (GravityBall->IsGravityActive)
+
+	for (int32 i = 0; i < InputComponent->GetNumActionBindings(); i++)
 	{
-		OnReturnGravityBall();
+		const FInputActionBinding& binding = InputComponent->GetActionBinding(i);
+		if (binding.GetActionName() == ActionName && binding.KeyEvent == KeyEvent)
+		{
+			binding.ActionDelegate.Execute(EKeys::Invalid);
+		}
 	}
 }
 
+void AFPSGameplayCharacter::InjectInputAxis(FName AxisName, float Value)
+{
+	if (!InputComponent)
+	{
+		return;
+	}
+
+	for (const FInputAxisBinding& binding : InputComponent->AxisBindings)
+	{
+		if (binding.AxisName == AxisName)
+		{
+			binding.AxisDelegate.Execute(Value);
+		}
+	}
+}
 
 void AFPSGameplayCharacter::OnFire()
 {
+	// the projectile spawn (actor, components, registration) is accounted to the projectiles
+	FPS_LLM_SCOPE(Projectiles);
+	FPS_ALLOC_SCOPE(Fire);
+
 	// try and fire a projectile
 	if (ProjectileClass != NULL)
 	{
 		UWorld* const World = GetWorld();
 		if (World != NULL)
 		{
-			if (bUsingMotionControllers)
+			if (bUsingMotionControllers && VR_MuzzleLocation)
 			{
 				const FRotator SpawnRotation = VR_MuzzleLocation->GetComponentRotation();
 				const FVector SpawnLocation = VR_MuzzleLocation->GetComponentLocation();
@@ -242,10 +403,14 @@ void AFPSGameplayCharacter::OnFire()
 		}
 	}
 
-	// try and play the sound if specified
+#if WITH_FPS_COSMETICS
+	// try and play the sound if specified, the shots of the players close to each other in a frame share a pooled voice
 	if (FireSound != NULL)
 	{
-		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation());
+		if (UGameplayAudioSubsystem* gameplayAudio = GetWorld()->GetSubsystem<UGameplayAudioSubsystem>())
+		{
+			gameplayAudio->PlaySoundAtLocation(FireSound, GetActorLocation(), this);
+		}
 	}
 
 	// try and play a firing animation if specified
@@ -258,6 +423,7 @@ void AFPSGameplayCharacter::OnFire()
 			AnimInstance->Montage_Play(FireAnimation, 1.f);
 		}
 	}
+#endif
 }
 
 void AFPSGameplayCharacter::OnShootGravityBall()
@@ -265,7 +431,15 @@ void AFPSGameplayCharacter::OnShootGravityBall()
 	if (GravityBall && !GravityBall->IsDettached)
 	{
 		GravityBall->ShootBall();
-		GravityBallTimer = GravityBallDuration;
+
+		// the ball comes back on its own after a while
+		FGravityGunCharacterState* state = GetGravityGunState();
+		UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+		if (state && timingWheel)
+		{
+			timingWheel->Cancel(state->BallTimeoutHandle);
+			state->BallTimeoutHandle = timingWheel->Schedule(GravityBallDuration, FSimpleDelegate::CreateUObject(this, &AFPSGameplayCharacter::OnGravityBallTimeout));
+		}
 	}
 	else if (GravityBall && GravityBall->IsMovingForward && GravityBall->IsDettached)
 	{
@@ -273,14 +447,41 @@ void AFPSGameplayCharacter::OnShootGravityBall()
 	}
 }
 
+void AFPSGameplayCharacter::OnGravityBallTimeout()
+{
+	// a ball still in flight comes back once it stops, like it did with the per frame countdown
+	if (GravityBall && GravityBall->IsDettached && !GravityBall->IsGravityActive)
+	{
+		FGravityGunCharacterState* state = GetGravityGunState();
+		UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+		if (state && timingWheel)
+		{
+			state->BallTimeoutHandle = timingWheel->Schedule(UTimingWheelSubsystem::TickSeconds, FSimpleDelegate::CreateUObject(this, &AFPSGameplayCharacter::OnGravityBallTimeout));
+		}
+		return;
+	}
+
+	OnReturnGravityBall();
+}
+
 void AFPSGameplayCharacter::OnReturnGravityBall()
 {
+	FGravityGunCharacterState* state = GetGravityGunState();
+	UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+	if (state && timingWheel)
+	{
+		timingWheel->Cancel(state->BallTimeoutHandle);
+	}
+
 	if (GravityBall && GravityBall->IsDettached)
 	{
 		GravityBall->IsDettached = false;
-		HookRope->SetVisibility(false);
-		GravityBall->AppearDissapearGravityBall(true);
-		GravityBall->ResizeAreaOfGravity(true);
+		if (HookRope)
+		{
+			HookRope->SetVisibility(false);
+		}
+		GravityBall->PlayGravityBallScale(true);
+		GravityBall->PlayAreaOfGravityScale(true);
 	}
 }
 
@@ -288,12 +489,82 @@ void AFPSGameplayCharacter::OnHook()
 {
 	if (GravityBall->GravityMode == E_GravityMode::MODE_HOOK && GravityBall->IsDettached && !GravityBall->IsMovingForward /*&& GetCharacterMovement()->IsFalling()*/)
 	{
-		HookRope->SetVisibility(true);
-		HookRope->SetWorldLocation(GravityBall->GetActorLocation());
-		HookRope->EndLocation = FVector::ZeroVector;
-		FVector distanceBallActor = FP_MuzzleLocationHook->GetComponentLocation() - GravityBall->GetActorLocation();
-		HookRope->CableLength = distanceBallActor.Size() - 500;
-		IsSwinging = true;
+		AttachHook(GravityBall->GetActorLocation(), true);
+	}
+	else if (HasHookTarget)
+	{
+		AttachHook(HookTargetLocation, false);
+	}
+}
+
+void AFPSGameplayCharacter::AttachHook(const FVector& Anchor, bool bHookedToBall)
+{
+	FPS_ALLOC_SCOPE(HookRope);
+
+	IsHookedToGravityBall = bHookedToBall;
+	HookAnchorLocation = Anchor;
+
+	if (UCableComponent* rope = GetHookRope())
+	{
+		rope->SetVisibility(true);
+		rope->SetWorldLocation(HookAnchorLocation);
+		rope->EndLocation = FVector::ZeroVector;
+		FVector distanceAnchorActor = FP_MuzzleLocationHook->GetComponentLocation() - HookAnchorLocation;
+		rope->CableLength = distanceAnchorActor.Size() - 500;
+	}
+	IsSwinging = true;
+	GetGravityGunMovement()->StartSwinging(HookAnchorLocation);
+
+	if (FGravityGunCharacterState* state = GetGravityGunState())
+	{
+		state->bSwinging = true;
+		state->bHookedToBall = IsHookedToGravityBall;
+	}
+}
+
+void AFPSGameplayCharacter::UpdateHookTarget()
+{
+	HasHookTarget = false;
+
+	if (UHookAnchorSubsystem* anchors = GetWorld()->GetSubsystem<UHookAnchorSubsystem>())
+	{
+		const FVector viewLocation = FirstPersonCameraComponent->GetComponentLocation();
+		const FVector viewDirection = GetControlRotation().Vector();
+		HasHookTarget = anchors->FindBestAnchor(viewLocation, viewDirection, MaxHookRange, HookConeHalfAngle, HookTargetLocation) != INDEX_NONE;
+	}
+}
+
+void AFPSGameplayCharacter::UpdateTrajectoryPreview()
+{
+	UWorld* const World = GetWorld();
+	const FRotator SpawnRotation = GetControlRotation();
+
+	// same spawn transform OnFire uses
+	if (ProjectileClass != NULL)
+	{
+		AFPSGameplayProjectile* projectileDefaults = ProjectileClass->GetDefaultObject<AFPSGameplayProjectile>();
+		UUProjectileMovementCompModified* projectileMove = projectileDefaults->GetProjectileMovement();
+
+		FTrajectoryLaunchParams launch;
+		launch.Location = ((FP_MuzzleLocation != nullptr) ? FP_MuzzleLocation->GetComponentLocation() : GetActorLocation()) + SpawnRotation.RotateVector(GunOffset);
+		launch.Velocity = SpawnRotation.Vector() * projectileMove->InitialSpeed;
+		launch.GravityZ = World->GetGravityZ() * projectileMove->ProjectileGravityScale;
+		launch.MaxSpeed = projectileMove->MaxSpeed;
+		launch.bShouldBounce = projectileMove->bShouldBounce;
+		launch.Bounciness = projectileMove->Bounciness;
+		launch.Friction = projectileMove->Friction;
+		launch.CollisionRadius = projectileDefaults->GetCollisionComp()->GetUnscaledSphereRadius();
+
+		ShotPredictor.PredictProjectile(World, launch, this);
+	}
+
+	if (GravityBall && !GravityBall->IsDettached)
+	{
+		FTrajectoryPredictor::PredictGravityBall(World, GravityBall->GetActorLocation(), SpawnRotation.Vector(), GravityBall->maxDistanceToplayer, this, PredictedGravityBallPath);
+	}
+	else
+	{
+		PredictedGravityBallPath.Reset();
 	}
 }
 
@@ -302,7 +573,7 @@ void AFPSGameplayCharacter::OnSetGravityModeAttraction()
 	if (GravityBall && GravityBall->GravityMode != E_GravityMode::MODE_ATTRACTION)
 	{
 		GravityBall->GravityMode = E_GravityMode::MODE_ATTRACTION;
-		GravityBall->ChangeGravityMaterial(AttractMaterialInstance);
+		GravityBall->PlayGravityModeVisuals(AttractMaterialInstance);
 		if (GameHud)
 		{
 			GameHud->ChangeGravityModeUI(0);
@@ -316,7 +587,7 @@ void AFPSGameplayCharacter::OnSetGravityModeRepulsion()
 	if (GravityBall && GravityBall->GravityMode != E_GravityMode::MODE_REPULSION)
 	{
 		GravityBall->GravityMode = E_GravityMode::MODE_REPULSION;
-		GravityBall->ChangeGravityMaterial(RepulsionMaterialInstance);
+		GravityBall->PlayGravityModeVisuals(RepulsionMaterialInstance);
 		if (GameHud)
 		{
 			GameHud->ChangeGravityModeUI(1);
@@ -330,7 +601,7 @@ void AFPSGameplayCharacter::OnSetGravityModeHook()
 	if (GravityBall && GravityBall->GravityMode != E_GravityMode::MODE_HOOK)
 	{
 		GravityBall->GravityMode = E_GravityMode::MODE_HOOK;
-		GravityBall->ChangeGravityMaterial(HookMaterialInstance);
+		GravityBall->PlayGravityModeVisuals(HookMaterialInstance);
 		if (GameHud)
 		{
 			GameHud->ChangeGravityModeUI(2);
@@ -341,26 +612,105 @@ void AFPSGameplayCharacter::OnSetGravityModeHook()
 
 void AFPSGameplayCharacter::HangFromGravityHook()
 {
-	HookRope->SetWorldLocation(GravityBall->GetActorLocation());
-	HookRope->EndLocation = FVector::ZeroVector;
-	FVector forceDirection = GetActorLocation() - GravityBall->GetActorLocation();
-	float forceMagnitude = FVector::DotProduct(GetVelocity(), forceDirection);
-	forceDirection.Normalize();
-	FVector forceVector = forceDirection * forceMagnitude * ForceSwingMagnitude;
-	GetCharacterMovement()->AddForce(forceVector);
+	// the pendulum itself runs in the movement component, here we only follow the anchor
+	if (IsHookedToGravityBall)
+	{
+		HookAnchorLocation = GravityBall->GetActorLocation();
+		GetGravityGunMovement()->SetSwingAnchor(HookAnchorLocation);
+	}
+	if (HookRope)
+	{
+		HookRope->SetWorldLocation(HookAnchorLocation);
+		HookRope->EndLocation = FVector::ZeroVector;
+	}
+}
+
+UGravityGunMovementComponent* AFPSGameplayCharacter::GetGravityGunMovement() const
+{
+	return CastChecked<UGravityGunMovementComponent>(GetCharacterMovement());
 }
 
 void AFPSGameplayCharacter::OnUnhook()
 {
-	HookRope->SetVisibility(false);
-	HookRope->EndLocation = FVector::ZeroVector;
-	HookRope->CableLength = 0;
+	if (HookRope)
+	{
+		HookRope->SetVisibility(false);
+		HookRope->EndLocation = FVector::ZeroVector;
+		HookRope->CableLength = 0;
+	}
 	IsSwinging = false;
+	GetGravityGunMovement()->StopSwinging();
+
+	if (FGravityGunCharacterState* state = GetGravityGunState())
+	{
+		state->bSwinging = false;
+	}
+}
+
+void AFPSGameplayCharacter::SerializeSnapshot(FArchive& Ar)
+{
+	FTransform transform = GetActorTransform();
+	FVector velocity = GetCharacterMovement()->Velocity;
+	FRotator controlRotation = GetControlRotation();
+	bool bSwinging = IsSwinging;
+	bool bHookedToBall = IsHookedToGravityBall;
+	FVector hookAnchor = HookAnchorLocation;
+	float ballTimeRemaining = GetGravityBallTimeRemaining();
+	Ar << transform << velocity << controlRotation << bSwinging << bHookedToBall << hookAnchor << ballTimeRemaining;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	SetActorTransform(transform, false, nullptr, ETeleportType::TeleportPhysics);
+	GetCharacterMovement()->Velocity = velocity;
+	if (Controller)
+	{
+		Controller->SetControlRotation(controlRotation);
+	}
+
+	if (IsSwinging)
+	{
+		OnUnhook();
+	}
+	if (bSwinging)
+	{
+		AttachHook(hookAnchor, bHookedToBall);
+	}
+
+	// the ball timer continues from where it was
+	FGravityGunCharacterState* state = GetGravityGunState();
+	UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+	if (state && timingWheel)
+	{
+		timingWheel->Cancel(state->BallTimeoutHandle);
+		if (ballTimeRemaining > 0.f)
+		{
+			state->BallTimeoutHandle = timingWheel->Schedule(ballTimeRemaining, FSimpleDelegate::CreateUObject(this, &AFPSGameplayCharacter::OnGravityBallTimeout));
+		}
+	}
+
+#if WITH_FPS_COSMETICS
+	// the ball only knows its mode, the materials and the HUD are on the character
+	if (GravityBall)
+	{
+		UMaterialInstance* modeMaterials[] = { AttractMaterialInstance, RepulsionMaterialInstance, HookMaterialInstance };
+		const int32 mode = (int32)GravityBall->GravityMode;
+		GravityBall->PlayGravityModeVisuals(modeMaterials[mode]);
+		if (GameHud)
+		{
+			GameHud->ChangeGravityModeUI(mode);
+		}
+	}
+#endif
 }
 
 void AFPSGameplayCharacter::OnResetVR()
 {
+#if WITH_FPS_VR
 	UHeadMountedDisplayFunctionLibrary::ResetOrientationAndPosition();
+#endif
 }
 
 void AFPSGameplayCharacter::BeginTouch(const ETouchIndex::Type FingerIndex, const FVector Location)
@@ -420,6 +770,7 @@ void AFPSGameplayCharacter::LookUpAtRate(float Rate)
 
 bool AFPSGameplayCharacter::EnableTouchscreenMovement(class UInputComponent* PlayerInputComponent)
 {
+#if WITH_FPS_TOUCH
 	if (FPlatformMisc::SupportsTouchInput() || GetDefault<UInputSettings>()->bUseMouseForTouch)
 	{
 		PlayerInputComponent->BindTouch(EInputEvent::IE_Pressed, this, &AFPSGameplayCharacter::BeginTouch);
@@ -429,6 +780,7 @@ bool AFPSGameplayCharacter::EnableTouchscreenMovement(class UInputComponent* Pla
 		//PlayerInputComponent->BindTouch(EInputEvent::IE_Repeat, this, &AFPSGameplayCharacter::TouchUpdate);
 		return true;
 	}
+#endif
 
 	return false;
 }
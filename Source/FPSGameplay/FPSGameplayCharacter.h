@@ -8,6 +8,7 @@
 #include "CableComponent.h"
 #include "Materials/MaterialInstance.h"
 #include "FPSGameplayHUD.h"
+#include "TrajectoryPredictor.h"
 #include "FPSGameplayCharacter.generated.h"
 
 
@@ -38,36 +39,45 @@ class AFPSGameplayCharacter : public ACharacter
 	UPROPERTY(VisibleDefaultsOnly, Category = Mesh)
 		class USceneComponent* FP_MuzzleLocationHook;
 
-	/** Gun mesh: VR view (attached to the VR controller directly, no arm, just the actual gun) */
-	UPROPERTY(VisibleDefaultsOnly, Category = Mesh)
+	/** Gun mesh: VR view (attached to the VR controller directly, no arm, just the actual gun). Only created when using motion controllers */
+	UPROPERTY(Transient)
 		class USkeletalMeshComponent* VR_Gun;
 
-	/** Location on VR gun mesh where projectiles should spawn. */
-	UPROPERTY(VisibleDefaultsOnly, Category = Mesh)
+	/** Location on VR gun mesh where projectiles should spawn. Only created when using motion controllers */
+	UPROPERTY(Transient)
 		class USceneComponent* VR_MuzzleLocation;
 
 	/** First person camera */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera, meta = (AllowPrivateAccess = "true"))
 		class UCameraComponent* FirstPersonCameraComponent;
 
-	/** Motion controller (right hand) */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
-		class UMotionControllerComponent* R_MotionController;
+	/** Motion controller (right hand). Only created when using motion controllers, a UMotionControllerComponent when it exists.
+	 *  Declared as a scene component so the headless server doesn't need the HeadMountedDisplay module */
+	UPROPERTY(Transient, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+		class USceneComponent* R_MotionController;
 
-	/** Motion controller (left hand) */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
-		class UMotionControllerComponent* L_MotionController;
+	/** Motion controller (left hand). Only created when using motion controllers, a UMotionControllerComponent when it exists */
+	UPROPERTY(Transient, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+		class USceneComponent* L_MotionController;
 
-	/** Motion controller (left hand) */
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	/** Rope drawn between the gun and the hook. Created the first time the player hooks, never on a dedicated server */
+	UPROPERTY(Transient, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 		class UCableComponent* HookRope;
 
 public:
-	AFPSGameplayCharacter();
+	AFPSGameplayCharacter(const FObjectInitializer& ObjectInitializer);
 
 protected:
 	virtual void BeginPlay();
 
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** The per frame gravity gun logic runs in a batch for all the characters */
+	friend class UGravityGunTickSubsystem;
+
+	/** State of this character in the gravity gun batch, null if it isn't registered */
+	struct FGravityGunCharacterState* GetGravityGunState() const;
+
 public:
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Camera)
@@ -101,17 +111,44 @@ public:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
 		bool IsSwinging;
 
-	/** Extra force added to the swing force (has to be negative)*/
+	/** True if the hook is attached to the gravity ball, false if it's attached to a hook anchor */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
-		float ForceSwingMagnitude = -6.f;
+		bool IsHookedToGravityBall;
+
+	/** Point the character is swinging around */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
+		FVector HookAnchorLocation;
+
+	/** Max distance to a hook anchor for it to be hookable */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
+		float MaxHookRange = 2500.f;
+
+	/** Half angle of the view cone hook anchors have to be in, in degrees */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
+		float HookConeHalfAngle = 20.f;
+
+	/** True if there is a hook anchor in range that OnHook would attach to */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
+		bool HasHookTarget;
+
+	/** Location of the hook anchor OnHook would attach to, valid when HasHookTarget is true */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
+		FVector HookTargetLocation;
+
+	/** True if the predicted path of the next shot (and of the gravity ball while it's in the gun) is shown in the HUD */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
+		bool ShowTrajectoryPreview = true;
 
 	/** How long can the gravity ball stay outside the player*/
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 		float GravityBallDuration = 10.f;
 
-	/** Timer for the gravity ball*/
-	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = Gameplay)
-		float GravityBallTimer;
+	/** Time left before the gravity ball comes back on its own */
+	UFUNCTION(BlueprintPure, Category = Gameplay)
+		float GetGravityBallTimeRemaining() const;
+
+	/** Saves or restores the transform, velocity, hook and ball timer, for UGameplaySnapshotSubsystem. The ball has to be restored first */
+	void SerializeSnapshot(FArchive& Ar);
 
 	/** Sound to play each time we fire */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
@@ -125,6 +162,18 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 		uint32 bUsingMotionControllers : 1;
 
+	/** Mesh of the VR gun, used when the VR components are created */
+	UPROPERTY(EditDefaultsOnly, Category = Mesh)
+		class USkeletalMesh* VRGunMesh;
+
+	/** Material of the hook rope, used when the rope is created */
+	UPROPERTY(EditDefaultsOnly, Category = Mesh)
+		class UMaterialInterface* HookRopeMaterial;
+
+	/** Width of the hook rope */
+	UPROPERTY(EditDefaultsOnly, Category = Mesh)
+		float HookRopeWidth = 3.f;
+
 	/** Reference to the gravity material instance to change its color */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
 		UMaterialInstance* AttractMaterialInstance;
@@ -152,12 +201,30 @@ protected:
 	/** Calls the gravity ball back */
 	void OnReturnGravityBall();
 
+	/** GravityBallDuration ran out since the ball was shot. Calls it back once it stopped moving */
+	void OnGravityBallTimeout();
+
 	/** Called when the player activates the hook action of the gravity gun */
 	void OnHook();
 
+	/** Attaches the hook rope and starts swinging around Anchor */
+	void AttachHook(const FVector& Anchor, bool bHookedToBall);
+
 	/** Called when the player is hanging from the hook */
 	void HangFromGravityHook();
 
+	/** Looks for the best hook anchor in the view cone, used by the HUD and by OnHook */
+	void UpdateHookTarget();
+
+	/** Updates the predicted paths shown in the HUD */
+	void UpdateTrajectoryPreview();
+
+	/** Predicts the path of the next shot through the active gravity fields */
+	FTrajectoryPredictor ShotPredictor;
+
+	/** Predicted flight of the gravity ball, empty when the ball is not in the gun */
+	TArray<FVector> PredictedGravityBallPath;
+
 	/** Called when the player stops hanging from the hook*/
 	void OnUnhook();
 
@@ -170,6 +237,12 @@ protected:
 	/** Called when the player changes the gravity mode of the ball to hook mode*/
 	void OnSetGravityModeHook();
 
+	/** Creates the motion controllers and the VR gun. Only called when using motion controllers outside a dedicated server */
+	void CreateMotionControllerComponents();
+
+	/** Returns the hook rope, creating it the first time. Returns null on a dedicated server where the rope is never seen */
+	class UCableComponent* GetHookRope();
+
 	/** Resets HMD orientation and position in VR. */
 	void OnResetVR();
 
@@ -218,13 +291,25 @@ protected:
 	bool EnableTouchscreenMovement(UInputComponent* InputComponent);
 
 public:
+	/** Gives a pawn without a player controller the same input bindings a player gets, used by the load test bots */
+	void InitializeBotInput();
+
+	/** Runs the bindings of an action as if its key had the given event */
+	void InjectInputAction(FName ActionName, EInputEvent KeyEvent);
+
+	/** Runs the bindings of an axis with the given value */
+	void InjectInputAxis(FName AxisName, float Value);
+
+	/** Returns the movement component, it runs the hook swing **/
+	class UGravityGunMovementComponent* GetGravityGunMovement() const;
 	/** Returns Mesh1P subobject **/
 	FORCEINLINE class USkeletalMeshComponent* GetMesh1P() const { return Mesh1P; }
+	/** Returns the predicted path of the next shot **/
+	FORCEINLINE const TArray<FVector>& GetPredictedShotPath() const { return ShotPredictor.GetPoints(); }
+	/** Returns the predicted flight of the gravity ball **/
+	FORCEINLINE const TArray<FVector>& GetPredictedGravityBallPath() const { return PredictedGravityBallPath; }
 	/** Returns FirstPersonCameraComponent subobject **/
 	FORCEINLINE class UCameraComponent* GetFirstPersonCameraComponent() const { return FirstPersonCameraComponent; }
 
-	// Called every frame
-	virtual void Tick(float DeltaTime) override;
-
 };
 
@@ -6,12 +6,17 @@
 #include "TextureResource.h"
 #include "CanvasItem.h"
 #include "UObject/ConstructorHelpers.h"
+#include "FPSGameplayCharacter.h"
 
 AFPSGameplayHUD::AFPSGameplayHUD()
 {
+#if WITH_FPS_HUD
 	// Set the crosshair texture
 	static ConstructorHelpers::FObjectFinder<UTexture2D> CrosshairTexObj(TEXT("/Game/FirstPerson/Textures/FirstPersonCrosshair"));
 	CrosshairTex = CrosshairTexObj.Object;
+#else
+	CrosshairTex = nullptr;
+#endif
 }
 
 
@@ -19,6 +24,7 @@ void AFPSGameplayHUD::DrawHUD()
 {
 	Super::DrawHUD();
 
+#if WITH_FPS_HUD
 	// Draw very simple crosshair
 
 	// find center of the Canvas
@@ -32,4 +38,41 @@ void AFPSGameplayHUD::DrawHUD()
 	FCanvasTileItem TileItem( CrosshairDrawPosition, CrosshairTex->Resource, FLinearColor::White);
 	TileItem.BlendMode = SE_BLEND_Translucent;
 	Canvas->DrawItem( TileItem );
+
+	AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(GetOwningPawn());
+	if (!character)
+	{
+		return;
+	}
+
+	// predicted paths of the next shot and of the gravity ball
+	DrawPolyline(character->GetPredictedShotPath(), FLinearColor(1.0f, 0.6f, 0.1f, 0.6f));
+	DrawPolyline(character->GetPredictedGravityBallPath(), FLinearColor(0.6f, 0.2f, 1.0f, 0.6f));
+
+	// highlight the hook anchor the player would attach to
+	if (character->HasHookTarget)
+	{
+		const FVector screenLocation = Project(character->HookTargetLocation);
+		if (screenLocation.Z > 0.f)
+		{
+			const float markerSize = 12.0f;
+			DrawRect(FLinearColor(0.2f, 0.8f, 1.0f, 0.8f), screenLocation.X - markerSize * 0.5f, screenLocation.Y - markerSize * 0.5f, markerSize, markerSize);
+		}
+	}
+#endif
+}
+
+void AFPSGameplayHUD::DrawPolyline(const TArray<FVector>& Points, const FLinearColor& Color)
+{
+	for (int32 i = 1; i < Points.Num(); i++)
+	{
+		const FVector start = Project(Points[i - 1]);
+		const FVector end = Project(Points[i]);
+
+		// skip the segments behind the camera
+		if (start.Z > 0.f && end.Z > 0.f)
+		{
+			DrawLine(start.X, start.Y, end.X, end.Y, Color, 2.0f);
+		}
+	}
 }
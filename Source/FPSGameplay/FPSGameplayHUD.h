@@ -20,6 +20,10 @@ public:
 	/*Changes the text for the gun gravity mode in the UI*/
 	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall)
 		void ChangeGravityModeUI(int mode);
+protected:
+	/** Draws a world space polyline projected on the screen */
+	void DrawPolyline(const TArray<FVector>& Points, const FLinearColor& Color);
+
 private:
 	/** Crosshair asset pointer */
 	class UTexture2D* CrosshairTex;
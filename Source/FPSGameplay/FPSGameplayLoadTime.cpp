@@ -0,0 +1,72 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGameplayLoadTime.h"
+#include "Engine/World.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
+#include "UObject/UObjectGlobals.h"
+
+namespace FPSGameplayLoadTime
+{
+	/** Start of the load being measured, the process start until the first map is ticked */
+	static double LoadStartTime = 0.0;
+	static double MapLoadStartTime = 0.0;
+	static double MapLoadSeconds = 0.0;
+	static FString LoadingMapName;
+	static bool bWaitingForTick = true;
+	static bool bFirstLoad = true;
+
+	static void OnPreLoadMap(const FString& MapName)
+	{
+		MapLoadStartTime = FPlatformTime::Seconds();
+		LoadingMapName = MapName;
+
+		// the first load is measured from the process start, it includes the engine init
+		if (!bFirstLoad)
+		{
+			LoadStartTime = MapLoadStartTime;
+		}
+		bWaitingForTick = true;
+	}
+
+	static void OnPostLoadMap(UWorld* World)
+	{
+		MapLoadSeconds = FPlatformTime::Seconds() - MapLoadStartTime;
+	}
+
+	static void OnWorldTickStart(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+	{
+		if (!bWaitingForTick || TickType != LEVELTICK_All || !World->IsGameWorld() || !World->HasBegunPlay())
+		{
+			return;
+		}
+		bWaitingForTick = false;
+
+		const double seconds = FPlatformTime::Seconds() - LoadStartTime;
+		UE_LOG(LogTemp, Display, TEXT("LoadTime: %s %s to first gameplay tick %.3f s (map load %.3f s, %d packages still loading)"),
+			*World->GetMapName(), bFirstLoad ? TEXT("process start") : TEXT("map load start"), seconds, MapLoadSeconds, GetNumAsyncPackages());
+		bFirstLoad = false;
+
+		if (FParse::Param(FCommandLine::Get(), TEXT("FPSLoadTimeExit")))
+		{
+			RequestEngineExit(TEXT("FPSLoadTimeExit"));
+		}
+	}
+
+	void Register()
+	{
+		// play in editor worlds are created after the editor startup, there's no load to measure
+		if (GIsEditor)
+		{
+			return;
+		}
+
+		// GStartTime is taken when the process starts, before the engine init
+		LoadStartTime = GStartTime;
+
+		FCoreUObjectDelegates::PreLoadMap.AddStatic(&OnPreLoadMap);
+		FCoreUObjectDelegates::PostLoadMapWithWorld.AddStatic(&OnPostLoadMap);
+		FWorldDelegates::OnWorldTickStart.AddStatic(&OnWorldTickStart);
+	}
+}
@@ -0,0 +1,16 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/**
+ * Load time logging of the gameplay maps. Logs a "LoadTime:" line with the time from process start to the first gameplay tick,
+ * and from the start of every later map load to its first tick. Run with -FPSLoadTimeExit to quit after the first one,
+ * Build/Linux/LoadTimeBenchmark.sh does that to measure cold and warm loads of the packaged game.
+ */
+namespace FPSGameplayLoadTime
+{
+	/** Binds the map load and world tick delegates, called once at module startup */
+	void Register();
+}
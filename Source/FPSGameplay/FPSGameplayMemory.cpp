@@ -0,0 +1,541 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGameplayMemory.h"
+#include "Containers/Ticker.h"
+#include "HAL/LowLevelMemStats.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformStackWalk.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/Crc.h"
+#include "FPSGameplayProjectile.h"
+#include "GravityBall.h"
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+DECLARE_LLM_MEMORY_STAT(TEXT("FPS Projectiles"), STAT_FPSProjectilesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("FPS Gravity System"), STAT_FPSGravitySystemLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("FPS Character Gameplay"), STAT_FPSCharacterGameplayLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("FPS Gameplay"), STAT_FPSGameplaySummaryLLM, STATGROUP_LLM);
+#endif
+
+static TAutoConsoleVariable<float> CVarSoakGrowthWarning(
+	TEXT("fps.Memory.SoakGrowthWarningMBPerHour"),
+	8.f,
+	TEXT("Growth rate of a gameplay LLM tag, in MB per hour, that gets flagged by the soak test"));
+
+static TAutoConsoleVariable<int32> CVarAllocCheckCallSites(
+	TEXT("fps.Memory.AllocCheckCallSites"),
+	1,
+	TEXT("1 records the call stack of the allocations fps.Memory.AllocCheck counts in the measured frames, to print the offenders"));
+
+namespace FPSGameplayMemory
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	static const TCHAR* TagNames[] = { TEXT("Projectiles"), TEXT("GravitySystem"), TEXT("CharacterGameplay") };
+	static const int32 NumTags = (int32)EFPSGameplayLLMTag::Count - (int32)EFPSGameplayLLMTag::Projectiles;
+	static_assert(UE_ARRAY_COUNT(TagNames) == NumTags, "One name per gameplay LLM tag");
+
+	/** Highest amount of every tag, sampled every frame by SamplePeaks */
+	static int64 PeakAmounts[NumTags] = {};
+
+	static int64 SampleTag(int32 TagIndex)
+	{
+		const ELLMTag tag = (ELLMTag)((int32)EFPSGameplayLLMTag::Projectiles + TagIndex);
+		const int64 amount = FLowLevelMemTracker::Get().GetTagAmountForTracker(ELLMTracker::Default, tag);
+		PeakAmounts[TagIndex] = FMath::Max(PeakAmounts[TagIndex], amount);
+		return amount;
+	}
+
+	static FDelegateHandle SamplePeaksHandle;
+
+	static bool SamplePeaks(float DeltaTime)
+	{
+		for (int32 i = 0; i < NumTags; i++)
+		{
+			SampleTag(i);
+		}
+		return true;
+	}
+#endif
+
+	void RegisterLLMTags()
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		FLowLevelMemTracker& tracker = FLowLevelMemTracker::Get();
+		tracker.RegisterProjectTag((int32)EFPSGameplayLLMTag::Projectiles, TagNames[0], GET_STATFNAME(STAT_FPSProjectilesLLM), GET_STATFNAME(STAT_FPSGameplaySummaryLLM));
+		tracker.RegisterProjectTag((int32)EFPSGameplayLLMTag::GravitySystem, TagNames[1], GET_STATFNAME(STAT_FPSGravitySystemLLM), GET_STATFNAME(STAT_FPSGameplaySummaryLLM));
+		tracker.RegisterProjectTag((int32)EFPSGameplayLLMTag::CharacterGameplay, TagNames[2], GET_STATFNAME(STAT_FPSCharacterGameplayLLM), GET_STATFNAME(STAT_FPSGameplaySummaryLLM));
+
+		// sampled every frame, a peak between two dumps would be missed otherwise
+		if (FLowLevelMemTracker::IsEnabled())
+		{
+			SamplePeaksHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateStatic(&SamplePeaks));
+		}
+#endif
+	}
+
+	void UnregisterLLMTags()
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		if (SamplePeaksHandle.IsValid())
+		{
+			FTicker::GetCoreTicker().RemoveTicker(SamplePeaksHandle);
+			SamplePeaksHandle.Reset();
+		}
+#endif
+	}
+
+	static void DumpMemory(UWorld* World)
+	{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		if (FLowLevelMemTracker::IsEnabled())
+		{
+			for (int32 i = 0; i < NumTags; i++)
+			{
+				const int64 current = SampleTag(i);
+				UE_LOG(LogTemp, Display, TEXT("LLM %-20s current %8.2f MB  peak %8.2f MB"), TagNames[i], current / (1024.0 * 1024.0), PeakAmounts[i] / (1024.0 * 1024.0));
+			}
+		}
+		else
+#endif
+		{
+			UE_LOG(LogTemp, Display, TEXT("LLM is disabled, run with -llm to get the memory per gameplay tag"));
+		}
+
+		int32 numProjectiles = 0;
+		for (TActorIterator<AFPSGameplayProjectile> it(World); it; ++it)
+		{
+			numProjectiles++;
+		}
+
+		int32 numGravityBalls = 0;
+		int32 numAffectedActors = 0;
+		for (TActorIterator<AGravityBall> it(World); it; ++it)
+		{
+			numGravityBalls++;
+			numAffectedActors += it->AffectedActors.Num() + it->AffectedProjectiles.Num();
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Live projectiles: %d  gravity balls: %d  affected actors: %d"), numProjectiles, numGravityBalls, numAffectedActors);
+	}
+
+	/** Soak test: samples the tags at a fixed interval and flags the ones that keep growing */
+	class FSoakTest
+	{
+	public:
+		void Start(float IntervalSeconds)
+		{
+			Stop();
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+			if (!FLowLevelMemTracker::IsEnabled())
+			{
+				UE_LOG(LogTemp, Warning, TEXT("The memory soak test needs LLM, run with -llm"));
+				return;
+			}
+
+			StartTime = FPlatformTime::Seconds();
+			for (TArray<FVector2D>& samples : Samples)
+			{
+				samples.Reset();
+			}
+			TickerHandle = FTicker::GetCoreTicker().AddTicker(FTickerDelegate::CreateRaw(this, &FSoakTest::Sample), IntervalSeconds);
+			UE_LOG(LogTemp, Display, TEXT("Memory soak test started, sampling every %.0f seconds"), IntervalSeconds);
+#endif
+		}
+
+		void Stop()
+		{
+			if (TickerHandle.IsValid())
+			{
+				FTicker::GetCoreTicker().RemoveTicker(TickerHandle);
+				TickerHandle.Reset();
+				UE_LOG(LogTemp, Display, TEXT("Memory soak test stopped"));
+			}
+		}
+
+	private:
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+		bool Sample(float DeltaTime)
+		{
+			const double hours = (FPlatformTime::Seconds() - StartTime) / 3600.0;
+			const float warningBytesPerHour = CVarSoakGrowthWarning.GetValueOnGameThread() * 1024.f * 1024.f;
+
+			for (int32 i = 0; i < NumTags; i++)
+			{
+				TArray<FVector2D>& samples = Samples[i];
+				samples.Add(FVector2D(hours, SampleTag(i)));
+
+				// least squares slope of the whole session, steady growth shows up even if every frame looks fine
+				const float slope = ComputeSlope(samples);
+				if (samples.Num() >= MinSamples && slope > warningBytesPerHour)
+				{
+					UE_LOG(LogTemp, Warning, TEXT("LLM tag %s keeps growing: %.2f MB per hour over %.2f hours"), TagNames[i], slope / (1024.f * 1024.f), hours);
+				}
+			}
+			return true;
+		}
+
+		static float ComputeSlope(const TArray<FVector2D>& Points)
+		{
+			double sumX = 0.0, sumY = 0.0, sumXY = 0.0, sumXX = 0.0;
+			for (const FVector2D& point : Points)
+			{
+				sumX += point.X;
+				sumY += point.Y;
+				sumXY += (double)point.X * point.Y;
+				sumXX += (double)point.X * point.X;
+			}
+			const double n = Points.Num();
+			const double denominator = n * sumXX - sumX * sumX;
+			return FMath::Abs(denominator) > SMALL_NUMBER ? (float)((n * sumXY - sumX * sumY) / denominator) : 0.f;
+		}
+
+		static const int32 MinSamples = 10;
+		TArray<FVector2D> Samples[NumTags];
+		double StartTime = 0.0;
+#endif
+		FDelegateHandle TickerHandle;
+	};
+
+	static FSoakTest SoakTest;
+
+	static FAutoConsoleCommandWithWorld DumpCommand(
+		TEXT("fps.Memory.Dump"),
+		TEXT("Prints the current and peak memory of the gameplay LLM tags and the number of live projectiles and gravity balls"),
+		FConsoleCommandWithWorldDelegate::CreateStatic(&DumpMemory));
+
+	static FAutoConsoleCommand SoakCommand(
+		TEXT("fps.Memory.Soak"),
+		TEXT("fps.Memory.Soak <interval seconds>: samples the gameplay LLM tags and flags steady growth. 0 stops the soak test"),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			const float interval = Args.Num() > 0 ? FCString::Atof(*Args[0]) : 60.f;
+			if (interval > 0.f)
+			{
+				SoakTest.Start(interval);
+			}
+			else
+			{
+				SoakTest.Stop();
+			}
+		}));
+
+#if WITH_FPS_ALLOC_TRACKING
+	int32 CurrentAllocScope = INDEX_NONE;
+
+	static const TCHAR* AllocScopeNames[] = { TEXT("GravityTick"), TEXT("CharacterTick"), TEXT("Fire"), TEXT("HookRope"), TEXT("ProjectileHit"), TEXT("GravityOverlap"), TEXT("HookRopeRender") };
+	static const int32 NumAllocScopes = (int32)EFPSAllocScope::Count;
+	static_assert(UE_ARRAY_COUNT(AllocScopeNames) == NumAllocScopes, "One name per allocation scope");
+
+	/** Scopes the steady state threshold applies to. Spawning projectiles and the cable's render data allocate every frame by design */
+	static const bool bInThreshold[] = { true, true, false, true, true, true, false };
+	static_assert(UE_ARRAY_COUNT(bInThreshold) == NumAllocScopes, "One threshold flag per allocation scope");
+
+	/** Allocations of one scope, the frame counters are folded into the rest at the end of every frame */
+	struct FAllocScopeCounters
+	{
+		int64 FrameAllocs = 0;
+		int64 FrameBytes = 0;
+		int64 TotalAllocs = 0;
+		int64 TotalBytes = 0;
+		int64 MaxFrameAllocs = 0;
+	};
+
+	/** Distinct call stack of the counted allocations */
+	struct FAllocCallSite
+	{
+		static const int32 MaxDepth = 16;
+
+		uint32 Hash;
+		int32 Scope;
+		int32 Depth;
+		uint64 BackTrace[MaxDepth];
+		int64 Allocs;
+		int64 Bytes;
+	};
+
+	/**
+	 * Allocator installed in front of GMalloc by the first fps.Memory.AllocCheck. It forwards everything and counts
+	 * the game thread allocations made inside an FPS_ALLOC_SCOPE. It runs inside the allocator, so it can't allocate:
+	 * the call sites go in a fixed table
+	 */
+	class FAllocCounter : public FMalloc
+	{
+	public:
+		explicit FAllocCounter(FMalloc* InInner)
+			: Inner(InInner)
+		{
+		}
+
+		virtual void* Malloc(SIZE_T Size, uint32 Alignment) override
+		{
+			CountAllocation(Size);
+			return Inner->Malloc(Size, Alignment);
+		}
+
+		virtual void* Realloc(void* Original, SIZE_T Size, uint32 Alignment) override
+		{
+			// a growing TArray comes through here, a realloc can move the block so it counts as an allocation
+			if (Size > 0)
+			{
+				CountAllocation(Size);
+			}
+			return Inner->Realloc(Original, Size, Alignment);
+		}
+
+		virtual void Free(void* Original) override { Inner->Free(Original); }
+		virtual SIZE_T QuantizeSize(SIZE_T Count, uint32 Alignment) override { return Inner->QuantizeSize(Count, Alignment); }
+		virtual bool GetAllocationSize(void* Original, SIZE_T& SizeOut) override { return Inner->GetAllocationSize(Original, SizeOut); }
+		virtual void Trim(bool bTrimThreadCaches) override { Inner->Trim(bTrimThreadCaches); }
+		virtual void SetupTLSCachesOnCurrentThread() override { Inner->SetupTLSCachesOnCurrentThread(); }
+		virtual void ClearAndDisableTLSCachesOnCurrentThread() override { Inner->ClearAndDisableTLSCachesOnCurrentThread(); }
+		virtual void InitializeStatsMetadata() override { Inner->InitializeStatsMetadata(); }
+		virtual void UpdateStats() override { Inner->UpdateStats(); }
+		virtual void GetAllocatorStats(FGenericMemoryStats& OutStats) override { Inner->GetAllocatorStats(OutStats); }
+		virtual void DumpAllocatorStats(FOutputDevice& Ar) override { Inner->DumpAllocatorStats(Ar); }
+		virtual bool IsInternallyThreadSafe() const override { return Inner->IsInternallyThreadSafe(); }
+		virtual bool ValidateHeap() override { return Inner->ValidateHeap(); }
+		virtual const TCHAR* GetDescriptiveName() override { return Inner->GetDescriptiveName(); }
+
+		bool bCounting = false;
+		bool bRecordCallSites = false;
+
+		FAllocScopeCounters Scopes[NumAllocScopes];
+
+		static const int32 MaxCallSites = 512;
+		FAllocCallSite CallSites[MaxCallSites];
+		int32 NumCallSites = 0;
+
+	private:
+		void CountAllocation(SIZE_T Size)
+		{
+			if (!bCounting || CurrentAllocScope == INDEX_NONE || bInsideCounter || !IsInGameThread())
+			{
+				return;
+			}
+
+			FAllocScopeCounters& scope = Scopes[CurrentAllocScope];
+			scope.FrameAllocs++;
+			scope.FrameBytes += Size;
+
+			if (bRecordCallSites)
+			{
+				// capturing the stack can allocate the first time, those allocations aren't counted
+				bInsideCounter = true;
+				RecordCallSite(Size);
+				bInsideCounter = false;
+			}
+		}
+
+		void RecordCallSite(SIZE_T Size)
+		{
+			uint64 backTrace[FAllocCallSite::MaxDepth];
+			const int32 depth = (int32)FPlatformStackWalk::CaptureStackBackTrace(backTrace, FAllocCallSite::MaxDepth);
+			const uint32 hash = FCrc::MemCrc32(backTrace, depth * sizeof(uint64), (uint32)CurrentAllocScope);
+
+			// open addressing, a full table keeps counting the scopes but stops adding call sites
+			for (int32 probe = 0; probe < MaxCallSites; probe++)
+			{
+				FAllocCallSite& callSite = CallSites[(hash + probe) % MaxCallSites];
+				if (callSite.Allocs == 0)
+				{
+					if (NumCallSites >= MaxCallSites / 2)
+					{
+						return;
+					}
+					callSite.Hash = hash;
+					callSite.Scope = CurrentAllocScope;
+					callSite.Depth = depth;
+					FMemory::Memcpy(callSite.BackTrace, backTrace, depth * sizeof(uint64));
+					NumCallSites++;
+				}
+				else if (callSite.Hash != hash || callSite.Scope != CurrentAllocScope || callSite.Depth != depth || FMemory::Memcmp(callSite.BackTrace, backTrace, depth * sizeof(uint64)) != 0)
+				{
+					continue;
+				}
+
+				callSite.Allocs++;
+				callSite.Bytes += Size;
+				return;
+			}
+		}
+
+		FMalloc* Inner;
+		bool bInsideCounter = false;
+	};
+
+	/** Counts the gameplay allocations of a warmup and a measured run of frames and checks the steady state against a threshold */
+	class FAllocCheck
+	{
+	public:
+		void Start(int32 InWarmupFrames, int32 InMeasuredFrames, int64 InMaxAllocsPerFrame)
+		{
+			if (!Counter)
+			{
+				// installed once and never removed, the blocks allocated before or after go to the same allocator
+				Counter = new FAllocCounter(GMalloc);
+				GMalloc = Counter;
+			}
+
+			WarmupFrames = FMath::Max(InWarmupFrames, 1);
+			MeasuredFrames = FMath::Max(InMeasuredFrames, 1);
+			MaxAllocsPerFrame = InMaxAllocsPerFrame;
+			FrameIndex = 0;
+			ResetCounters();
+			Counter->bCounting = true;
+			Counter->bRecordCallSites = false;
+
+			if (!EndFrameHandle.IsValid())
+			{
+				EndFrameHandle = FCoreDelegates::OnEndFrame.AddRaw(this, &FAllocCheck::EndFrame);
+			}
+			UE_LOG(LogTemp, Display, TEXT("Allocation check started: %d warmup frames, %d measured frames, at most %lld allocations per frame"), WarmupFrames, MeasuredFrames, MaxAllocsPerFrame);
+		}
+
+		bool IsRunning() const
+		{
+			return EndFrameHandle.IsValid();
+		}
+
+		int64 GetMaxFrameAllocs() const
+		{
+			return MaxFrameAllocs;
+		}
+
+	private:
+		void ResetCounters()
+		{
+			for (FAllocScopeCounters& scope : Counter->Scopes)
+			{
+				scope = FAllocScopeCounters();
+			}
+			FMemory::Memzero(Counter->CallSites, sizeof(Counter->CallSites));
+			Counter->NumCallSites = 0;
+			MaxFrameAllocs = 0;
+		}
+
+		void EndFrame()
+		{
+			int64 frameAllocs = 0;
+			for (int32 i = 0; i < NumAllocScopes; i++)
+			{
+				FAllocScopeCounters& scope = Counter->Scopes[i];
+				frameAllocs += bInThreshold[i] ? scope.FrameAllocs : 0;
+				scope.TotalAllocs += scope.FrameAllocs;
+				scope.TotalBytes += scope.FrameBytes;
+				scope.MaxFrameAllocs = FMath::Max(scope.MaxFrameAllocs, scope.FrameAllocs);
+				scope.FrameAllocs = 0;
+				scope.FrameBytes = 0;
+			}
+			MaxFrameAllocs = FMath::Max(MaxFrameAllocs, frameAllocs);
+
+			FrameIndex++;
+			if (FrameIndex == WarmupFrames)
+			{
+				// the level and the pools are warm, from here on every allocation is an offender
+				ResetCounters();
+				Counter->bRecordCallSites = CVarAllocCheckCallSites.GetValueOnGameThread() != 0;
+			}
+			else if (FrameIndex == WarmupFrames + MeasuredFrames)
+			{
+				Counter->bCounting = false;
+				Counter->bRecordCallSites = false;
+				FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+				EndFrameHandle.Reset();
+				Report();
+			}
+		}
+
+		void Report()
+		{
+			for (int32 i = 0; i < NumAllocScopes; i++)
+			{
+				const FAllocScopeCounters& scope = Counter->Scopes[i];
+				UE_LOG(LogTemp, Display, TEXT("Allocations %-15s %8.2f per frame (peak %lld)  %10.1f bytes per frame%s"),
+					AllocScopeNames[i], (double)scope.TotalAllocs / MeasuredFrames, scope.MaxFrameAllocs, (double)scope.TotalBytes / MeasuredFrames, bInThreshold[i] ? TEXT("") : TEXT("  (not in the threshold)"));
+			}
+
+			if (MaxFrameAllocs <= MaxAllocsPerFrame)
+			{
+				UE_LOG(LogTemp, Display, TEXT("Allocation check PASSED: at most %lld gameplay allocations per frame over %d frames, the threshold is %lld"), MaxFrameAllocs, MeasuredFrames, MaxAllocsPerFrame);
+				return;
+			}
+
+			UE_LOG(LogTemp, Error, TEXT("Allocation check FAILED: up to %lld gameplay allocations per frame over %d frames, the threshold is %lld"), MaxFrameAllocs, MeasuredFrames, MaxAllocsPerFrame);
+
+			// the worst call sites, symbolized now that the counter is off
+			TArray<const FAllocCallSite*> callSites;
+			for (const FAllocCallSite& callSite : Counter->CallSites)
+			{
+				if (callSite.Allocs > 0 && bInThreshold[callSite.Scope])
+				{
+					callSites.Add(&callSite);
+				}
+			}
+			callSites.Sort([](const FAllocCallSite& A, const FAllocCallSite& B) { return A.Allocs > B.Allocs; });
+
+			const int32 numReported = FMath::Min(callSites.Num(), MaxReportedCallSites);
+			for (int32 i = 0; i < numReported; i++)
+			{
+				const FAllocCallSite& callSite = *callSites[i];
+				UE_LOG(LogTemp, Error, TEXT("Offender %d: %lld allocations, %lld bytes in %s"), i + 1, callSite.Allocs, callSite.Bytes, AllocScopeNames[callSite.Scope]);
+
+				// the first frames are the counter and FMemory
+				for (int32 frame = SkippedFrames; frame < callSite.Depth; frame++)
+				{
+					ANSICHAR symbol[1024] = {};
+					FPlatformStackWalk::ProgramCounterToHumanReadableString(frame, callSite.BackTrace[frame], symbol, UE_ARRAY_COUNT(symbol));
+					UE_LOG(LogTemp, Error, TEXT("    %s"), ANSI_TO_TCHAR(symbol));
+				}
+			}
+			if (callSites.Num() == 0)
+			{
+				UE_LOG(LogTemp, Error, TEXT("No call sites were recorded, set fps.Memory.AllocCheckCallSites 1 to get them"));
+			}
+		}
+
+		static const int32 MaxReportedCallSites = 10;
+		static const int32 SkippedFrames = 3;
+
+		FAllocCounter* Counter = nullptr;
+		FDelegateHandle EndFrameHandle;
+		int32 WarmupFrames = 0;
+		int32 MeasuredFrames = 0;
+		int32 FrameIndex = 0;
+		int64 MaxAllocsPerFrame = 0;
+		int64 MaxFrameAllocs = 0;
+	};
+
+	static FAllocCheck AllocCheck;
+
+	void StartAllocCheck(int32 WarmupFrames, int32 MeasuredFrames, int64 MaxAllocsPerFrame)
+	{
+		AllocCheck.Start(WarmupFrames, MeasuredFrames, MaxAllocsPerFrame);
+	}
+
+	bool IsAllocCheckRunning()
+	{
+		return AllocCheck.IsRunning();
+	}
+
+	int64 GetAllocCheckMaxFrameAllocs()
+	{
+		return AllocCheck.GetMaxFrameAllocs();
+	}
+
+	static FAutoConsoleCommand AllocCheckCommand(
+		TEXT("fps.Memory.AllocCheck"),
+		TEXT("fps.Memory.AllocCheck [warmup frames] [measured frames] [max allocations per frame]: counts the heap allocations of the gameplay scopes, ")
+		TEXT("logs PASSED or FAILED for the steady state frames and the call stacks of the offenders. ")
+		TEXT("For the bot scenario: -ExecCmds=\"fps.Bots.Spawn 8 3 1, fps.Memory.AllocCheck 300 600 0\""),
+		FConsoleCommandWithArgsDelegate::CreateLambda([](const TArray<FString>& Args)
+		{
+			const int32 warmupFrames = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 120;
+			const int32 measuredFrames = Args.Num() > 1 ? FCString::Atoi(*Args[1]) : 600;
+			const int64 maxAllocsPerFrame = Args.Num() > 2 ? FCString::Atoi64(*Args[2]) : 0;
+			StartAllocCheck(warmupFrames, measuredFrames, maxAllocsPerFrame);
+		}));
+#endif
+}
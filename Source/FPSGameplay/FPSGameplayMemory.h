@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+/**
+ * Low level memory tracker tags of the gameplay module. Run with -llm to enable them,
+ * then use fps.Memory.Dump to print the usage per tag and fps.Memory.Soak to watch for steady growth.
+ */
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+
+enum class EFPSGameplayLLMTag : int32
+{
+	/** Projectile actors and their components */
+	Projectiles = (int32)ELLMTag::ProjectTagStart,
+	/** Gravity balls, affected actor arrays and the gravity subsystems */
+	GravitySystem,
+	/** Character gameplay components: hook rope, VR components, gravity gun state */
+	CharacterGameplay,
+
+	Count
+};
+
+#define FPS_LLM_SCOPE(Tag) LLM_SCOPE((ELLMTag)EFPSGameplayLLMTag::Tag)
+
+#else
+
+#define FPS_LLM_SCOPE(Tag)
+
+#endif
+
+/**
+ * Heap allocation counting of the gameplay code, for fps.Memory.AllocCheck. Allocations made on the game thread
+ * inside an FPS_ALLOC_SCOPE are attributed to the innermost scope, the rest aren't counted.
+ */
+#define WITH_FPS_ALLOC_TRACKING !UE_BUILD_SHIPPING
+
+enum class EFPSAllocScope : int32
+{
+	/** Gravity field update of every ball */
+	GravityTick,
+	/** Batched gravity gun tick of the characters */
+	CharacterTick,
+	/** Projectile spawn when firing. Spawning an actor allocates, it's reported but not held to the threshold */
+	Fire,
+	/** Hook rope setup when hooking, and the rope's cable simulation */
+	HookRope,
+	/** Projectile hit handler */
+	ProjectileHit,
+	/** Gravity area overlap handlers */
+	GravityOverlap,
+	/** Render data the hook rope sends every frame. The cable component allocates it by design, it's reported but not held to the threshold */
+	HookRopeRender,
+
+	Count
+};
+
+#if WITH_FPS_ALLOC_TRACKING
+
+#define FPS_ALLOC_SCOPE(Scope) FPSGameplayMemory::FAllocScope PREPROCESSOR_JOIN(allocScope, __LINE__)(EFPSAllocScope::Scope)
+
+#else
+
+#define FPS_ALLOC_SCOPE(Scope)
+
+#endif
+
+namespace FPSGameplayMemory
+{
+	/** Registers the LLM tags, called when the module starts up */
+	void RegisterLLMTags();
+
+	/** Stops sampling the tag peaks, called when the module shuts down. The tags themselves stay registered with LLM */
+	void UnregisterLLMTags();
+
+#if WITH_FPS_ALLOC_TRACKING
+	/** Starts counting the gameplay allocations like fps.Memory.AllocCheck */
+	void StartAllocCheck(int32 WarmupFrames, int32 MeasuredFrames, int64 MaxAllocsPerFrame);
+
+	/** True until the measured frames of the last started check are done */
+	bool IsAllocCheckRunning();
+
+	/** Most allocations in one measured frame of the last finished check, in the scopes held to the threshold */
+	int64 GetAllocCheckMaxFrameAllocs();
+
+	/** Innermost allocation scope of the game thread, INDEX_NONE outside of them */
+	extern int32 CurrentAllocScope;
+
+	/** Attributes the game thread allocations to a scope while it's alive */
+	class FAllocScope
+	{
+	public:
+		explicit FAllocScope(EFPSAllocScope Scope)
+			: PreviousScope(CurrentAllocScope)
+		{
+			if (IsInGameThread())
+			{
+				CurrentAllocScope = (int32)Scope;
+			}
+		}
+
+		~FAllocScope()
+		{
+			if (IsInGameThread())
+			{
+				CurrentAllocScope = PreviousScope;
+			}
+		}
+
+	private:
+		int32 PreviousScope;
+	};
+#endif
+}
@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "FPSGameplayMemory.h"
+#include "Misc/AutomationTest.h"
+#include "Tests/AutomationCommon.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_FPS_ALLOC_TRACKING
+
+static TAutoConsoleVariable<int32> CVarAllocTestMaxAllocsPerFrame(
+	TEXT("fps.Memory.AllocTestMaxAllocsPerFrame"),
+	0,
+	TEXT("Most gameplay allocations per steady state frame the FPSGameplay.Memory.SteadyStateAllocations test accepts. Firing and the rope's render data aren't counted"));
+
+/** Spawns the bots of the scenario and starts counting */
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FStartAllocCheckCommand, FAutomationTestBase*, Test, int64, MaxAllocsPerFrame);
+
+bool FStartAllocCheckCommand::Update()
+{
+	UWorld* world = AutomationCommon::GetAnyGameWorld();
+	if (!world)
+	{
+		Test->AddError(TEXT("No game world to run the allocation check in"));
+		return true;
+	}
+
+	GEngine->Exec(world, TEXT("fps.Bots.Spawn 8 3 1"));
+	FPSGameplayMemory::StartAllocCheck(300, 600, MaxAllocsPerFrame);
+	return true;
+}
+
+/** Waits for the measured frames and checks the worst one against the threshold */
+DEFINE_LATENT_AUTOMATION_COMMAND_TWO_PARAMETER(FWaitForAllocCheckCommand, FAutomationTestBase*, Test, int64, MaxAllocsPerFrame);
+
+bool FWaitForAllocCheckCommand::Update()
+{
+	if (FPSGameplayMemory::IsAllocCheckRunning())
+	{
+		return false;
+	}
+
+	const int64 maxFrameAllocs = FPSGameplayMemory::GetAllocCheckMaxFrameAllocs();
+	Test->TestTrue(FString::Printf(TEXT("At most %lld gameplay allocations per steady state frame, the worst frame had %lld. The log has the offenders"), MaxAllocsPerFrame, maxFrameAllocs), maxFrameAllocs <= MaxAllocsPerFrame);
+
+	if (UWorld* world = AutomationCommon::GetAnyGameWorld())
+	{
+		GEngine->Exec(world, TEXT("fps.Bots.Clear"));
+	}
+	return true;
+}
+
+/** Same scenario as fps.Memory.AllocCheck run by hand: 8 mixed profile bots on the example map, 300 warmup frames and 600 measured frames */
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSteadyStateAllocationsTest, "FPSGameplay.Memory.SteadyStateAllocations", EAutomationTestFlags::ClientContext | EAutomationTestFlags::PerfFilter)
+
+bool FSteadyStateAllocationsTest::RunTest(const FString& Parameters)
+{
+	if (!AutomationOpenMap(TEXT("/Game/FirstPersonCPP/Maps/FirstPersonExampleMap")))
+	{
+		AddError(TEXT("Couldn't open the example map"));
+		return false;
+	}
+
+	const int64 maxAllocsPerFrame = CVarAllocTestMaxAllocsPerFrame.GetValueOnGameThread();
+	ADD_LATENT_AUTOMATION_COMMAND(FStartAllocCheckCommand(this, maxAllocsPerFrame));
+	ADD_LATENT_AUTOMATION_COMMAND(FWaitForAllocCheckCommand(this, maxAllocsPerFrame));
+	return true;
+}
+
+#endif
@@ -3,14 +3,19 @@
 #include "FPSGameplayProjectile.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
+#include "FPSGameplayMemory.h"
+#include "ProjectileRenderSubsystem.h"
+#include "Components/StaticMeshComponent.h"
+#include "CollisionEventQueueSubsystem.h"
 
 AFPSGameplayProjectile::AFPSGameplayProjectile() 
 {
+	FPS_LLM_SCOPE(Projectiles);
+
 	// Use a sphere as a simple collision representation
 	CollisionComp = CreateDefaultSubobject<USphereComponent>(TEXT("SphereComp"));
 	CollisionComp->InitSphereRadius(5.0f);
 	CollisionComp->BodyInstance.SetCollisionProfileName("Projectile");
-	CollisionComp->OnComponentHit.AddDynamic(this, &AFPSGameplayProjectile::OnHit);		// set up a notification for when this component hits something blocking
 
 	// Players can't walk on it
 	CollisionComp->SetWalkableSlopeOverride(FWalkableSlopeOverride(WalkableSlope_Unwalkable, 0.f));
@@ -27,16 +32,143 @@ AFPSGameplayProjectile::AFPSGameplayProjectile()
 	ProjectileMovement->bRotationFollowsVelocity = true;
 	ProjectileMovement->bShouldBounce = true;
 
-	// Die after 3 seconds by default
-	InitialLifeSpan = 3.0f;
+	// Die after 3 seconds by default. The timing wheel handles it, InitialLifeSpan would add one timer per projectile
+	InitialLifeSpan = 0.f;
+	ProjectileLifeSpan = 3.0f;
+
+	bInstancedRendering = false;
+}
+
+void AFPSGameplayProjectile::OnConstruction(const FTransform& Transform)
+{
+	Super::OnConstruction(Transform);
+
+	// the mesh is a component of the Blueprint, it only exists once the construction script ran.
+	// In the instanced render mode it leaves the scene right away: no scene proxy and no transform updates
+	if (UProjectileRenderSubsystem::IsInstancedRenderingEnabled() && GetWorld() && GetWorld()->IsGameWorld())
+	{
+		InstancedMesh = FindComponentByClass<UStaticMeshComponent>();
+		if (InstancedMesh)
+		{
+			InstancedMesh->bAutoRegister = false;
+			if (InstancedMesh->IsRegistered())
+			{
+				InstancedMesh->UnregisterComponent();
+			}
+		}
+	}
+}
+
+void AFPSGameplayProjectile::BeginPlay()
+{
+	Super::BeginPlay();
+
+	// set up a notification for when this component hits something blocking, NotifyHit forwards the hits
+	if (UCollisionEventQueueSubsystem* collisionQueue = GetWorld()->GetSubsystem<UCollisionEventQueueSubsystem>())
+	{
+		collisionQueue->RegisterComponent(CollisionComp, ECollisionHandlerType::ProjectileHit, FCollisionEventHandler::CreateUObject(this, &AFPSGameplayProjectile::OnHit));
+	}
+
+	if (InstancedMesh)
+	{
+		if (UProjectileRenderSubsystem* projectileRender = GetWorld()->GetSubsystem<UProjectileRenderSubsystem>())
+		{
+			projectileRender->AddProjectile(this, InstancedMesh->GetStaticMesh(), InstancedMesh->GetMaterial(0), InstancedMesh->GetRelativeTransform());
+			projectileRender->CountSkippedRegistration();
+		}
+
+		// the component isn't needed anymore, destroying it also takes it out of the attachment hierarchy
+		InstancedMesh->DestroyComponent();
+		InstancedMesh = nullptr;
+		bInstancedRendering = true;
+	}
+
+	if (ProjectileLifeSpan > 0.f)
+	{
+		if (UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>())
+		{
+			LifeSpanHandle = timingWheel->Schedule(ProjectileLifeSpan, FSimpleDelegate::CreateUObject(this, &AFPSGameplayProjectile::OnLifeSpanExpired));
+		}
+	}
 }
 
-void AFPSGameplayProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+void AFPSGameplayProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
 {
-	// Only add impulse and destroy projectile if we hit a physics
-	if ((OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
+	if (UCollisionEventQueueSubsystem* collisionQueue = GetWorld()->GetSubsystem<UCollisionEventQueueSubsystem>())
+	{
+		collisionQueue->UnregisterComponent(CollisionComp);
+	}
+
+	if (bInstancedRendering)
+	{
+		if (UProjectileRenderSubsystem* projectileRender = GetWorld()->GetSubsystem<UProjectileRenderSubsystem>())
+		{
+			projectileRender->RemoveProjectile(this);
+		}
+	}
+
+	if (UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>())
+	{
+		timingWheel->Cancel(LifeSpanHandle);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AFPSGameplayProjectile::NotifyHit(UPrimitiveComponent* MyComp, AActor* Other, UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit)
+{
+	Super::NotifyHit(MyComp, Other, OtherComp, bSelfMoved, HitLocation, HitNormal, NormalImpulse, Hit);
+
+	// the projectile movement bounces after the hit notifies, its velocity is still the one it hit with
+	if (UCollisionEventQueueSubsystem* collisionQueue = GetWorld()->GetSubsystem<UCollisionEventQueueSubsystem>())
+	{
+		collisionQueue->QueueHit(MyComp, Other, OtherComp, NormalImpulse, Hit, ProjectileMovement->Velocity);
+	}
+}
+
+void AFPSGameplayProjectile::OnLifeSpanExpired()
+{
+	LifeSpanHandle.Invalidate();
+	Destroy();
+}
+
+void AFPSGameplayProjectile::SerializeSnapshot(FArchive& Ar)
+{
+	UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>();
+
+	bool bHoming = ProjectileMovement->bIsHomingProjectile;
+	UObject* homingTarget = ProjectileMovement->HomingTargetComponent.Get();
+	float lifeSpanRemaining = timingWheel ? timingWheel->GetTimeRemaining(LifeSpanHandle) : 0.f;
+	Ar << ProjectileMovement->Velocity << bHoming << homingTarget << ProjectileMovement->bIsHomingInverted << ProjectileMovement->HomingAccelerationMagnitude << lifeSpanRemaining;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	ProjectileMovement->bIsHomingProjectile = bHoming;
+	ProjectileMovement->HomingTargetComponent = Cast<USceneComponent>(homingTarget);
+	ProjectileMovement->UpdateComponentVelocity();
+
+	if (timingWheel)
+	{
+		// a snapshot taken as the life span ran out still expires, on the next wheel tick
+		timingWheel->Cancel(LifeSpanHandle);
+		LifeSpanHandle = timingWheel->Schedule(FMath::Max(lifeSpanRemaining, KINDA_SMALL_NUMBER), FSimpleDelegate::CreateUObject(this, &AFPSGameplayProjectile::OnLifeSpanExpired));
+	}
+}
+
+void AFPSGameplayProjectile::OnHit(const FCollisionQueueEvent& Event)
+{
+	FPS_ALLOC_SCOPE(ProjectileHit);
+
+	AActor* OtherActor = Event.GetOtherActor();
+	UPrimitiveComponent* OtherComp = Event.GetOtherComponent();
+
+	// Only add impulse and destroy projectile if we hit a physics. A hit queued after another one already destroyed it is ignored
+	if (!IsPendingKill() && (OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
 	{
-		OtherComp->AddImpulseAtLocation(GetVelocity() * 100.0f, GetActorLocation());
+		OtherComp->AddImpulseAtLocation(Event.Velocity * 100.0f, Event.Hit.ImpactPoint);
 
 		Destroy();
 	}
@@ -5,6 +5,7 @@
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
 #include "UProjectileMovementCompModified.h"
+#include "TimingWheelSubsystem.h"
 #include "FPSGameplayProjectile.generated.h"
 
 UCLASS(config=Game)
@@ -23,10 +24,39 @@ class AFPSGameplayProjectile : public AActor
 public:
 	AFPSGameplayProjectile();
 
-	/** called when projectile hits something */
-	UFUNCTION()
-	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+	/** Seconds before the projectile is destroyed. The expiration is tracked by UTimingWheelSubsystem instead of InitialLifeSpan */
+	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = Projectile)
+	float ProjectileLifeSpan;
 
+	/** Saves or restores the velocity, homing and remaining life span, for UGameplaySnapshotSubsystem. The transform is restored by the subsystem */
+	void SerializeSnapshot(FArchive& Ar);
+
+	/** called when projectile hits something, by UCollisionEventQueueSubsystem once physics is done */
+	void OnHit(const struct FCollisionQueueEvent& Event);
+
+protected:
+	virtual void OnConstruction(const FTransform& Transform) override;
+
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Queues the hits of CollisionComp for OnHit, with the velocity from before the bounce */
+	virtual void NotifyHit(class UPrimitiveComponent* MyComp, AActor* Other, class UPrimitiveComponent* OtherComp, bool bSelfMoved, FVector HitLocation, FVector HitNormal, FVector NormalImpulse, const FHitResult& Hit) override;
+
+	/** Called by the timing wheel when the life span is over */
+	void OnLifeSpanExpired();
+
+	FTimingWheelHandle LifeSpanHandle;
+
+	/** Mesh drawn by UProjectileRenderSubsystem instead of its own component, null in the regular render mode */
+	UPROPERTY(Transient)
+	class UStaticMeshComponent* InstancedMesh;
+
+	/** True if the projectile is drawn by UProjectileRenderSubsystem */
+	bool bInstancedRendering;
+
+public:
 	/** Returns CollisionComp subobject **/
 	FORCEINLINE class USphereComponent* GetCollisionComp() const { return CollisionComp; }
 	/** Returns ProjectileMovement subobject **/
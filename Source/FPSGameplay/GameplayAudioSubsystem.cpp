@@ -0,0 +1,254 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GameplayAudioSubsystem.h"
+#include "Components/AudioComponent.h"
+#include "Sound/SoundBase.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPSGameplayMemory.h"
+
+static TAutoConsoleVariable<int32> CVarAudioMaxVoices(
+	TEXT("fps.Audio.MaxVoices"),
+	32,
+	TEXT("Gameplay sound voices playing at the same time in the world, the requests over it are dropped"));
+
+static TAutoConsoleVariable<int32> CVarAudioMaxVoicesPerSource(
+	TEXT("fps.Audio.MaxVoicesPerSource"),
+	2,
+	TEXT("Gameplay sound voices playing at the same time for one source, its oldest voice is restarted when it runs out. 0 is unlimited"));
+
+static TAutoConsoleVariable<float> CVarAudioMaxMergedVolumeScale(
+	TEXT("fps.Audio.MaxMergedVolumeScale"),
+	2.f,
+	TEXT("Highest volume scale of the requests merged in the same frame. N merged requests play at sqrt(N) times their volume"));
+
+static TAutoConsoleVariable<float> CVarAudioMergeCellSize(
+	TEXT("fps.Audio.MergeCellSize"),
+	2000.f,
+	TEXT("Size of the grid cells the requests of a frame are merged in, the same sound in the same cell plays once at the average location. 0 merges a sound over the whole world"));
+
+static TAutoConsoleVariable<float> CVarAudioMaxVoiceDuration(
+	TEXT("fps.Audio.MaxVoiceDuration"),
+	10.f,
+	TEXT("Seconds a voice is kept busy for sounds that loop or don't know their duration"));
+
+static FAutoConsoleCommandWithWorld AudioStatsCommand(
+	TEXT("fps.Audio.Stats"),
+	TEXT("Logs the gameplay audio counters since the last call: active voices, requests played, merged, stolen and dropped"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UGameplayAudioSubsystem* gameplayAudio = World->GetSubsystem<UGameplayAudioSubsystem>())
+		{
+			gameplayAudio->ReportStats();
+		}
+	}));
+
+void FGameplayAudioTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->FlushRequests();
+	}
+}
+
+FString FGameplayAudioTickFunction::DiagnosticMessage()
+{
+	return TEXT("FGameplayAudioTickFunction");
+}
+
+void UGameplayAudioSubsystem::Deinitialize()
+{
+	if (AudioTickFunction.IsTickFunctionRegistered())
+	{
+		AudioTickFunction.UnRegisterTickFunction();
+	}
+	Voices.Reset();
+	Requests.Reset();
+	RequestIndices.Reset();
+
+	Super::Deinitialize();
+}
+
+void UGameplayAudioSubsystem::PlaySoundAtLocation(USoundBase* Sound, const FVector& Location, const UObject* Source, float VolumeMultiplier)
+{
+	if (!Sound)
+	{
+		return;
+	}
+
+	// the tick function is registered with the first request, the level is guaranteed to exist by then
+	if (!AudioTickFunction.IsTickFunctionRegistered())
+	{
+		AudioTickFunction.Owner = this;
+		AudioTickFunction.bCanEverTick = true;
+		AudioTickFunction.TickGroup = TG_PostUpdateWork;
+		AudioTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	NumRequests++;
+
+	// the shots of every player close to each other play once, a sound far away gets its own playback
+	const float cellSize = CVarAudioMergeCellSize.GetValueOnGameThread();
+	const FIntVector cell = cellSize > 0.f ? FIntVector(FMath::FloorToInt(Location.X / cellSize), FMath::FloorToInt(Location.Y / cellSize), FMath::FloorToInt(Location.Z / cellSize)) : FIntVector::ZeroValue;
+	const TPair<USoundBase*, FIntVector> key(Sound, cell);
+	if (const int32* requestIndex = RequestIndices.Find(key))
+	{
+		FGameplayAudioRequest& request = Requests[*requestIndex];
+		request.LocationSum += Location;
+		request.VolumeMultiplier += VolumeMultiplier;
+		request.Count++;
+		NumMerged++;
+		return;
+	}
+
+	FGameplayAudioRequest& request = Requests.AddDefaulted_GetRef();
+	request.Sound = Sound;
+	request.Source = Source;
+	request.LocationSum = Location;
+	request.VolumeMultiplier = VolumeMultiplier;
+	request.Count = 1;
+	RequestIndices.Add(key, Requests.Num() - 1);
+}
+
+int32 UGameplayAudioSubsystem::AcquireVoice(USoundBase* Sound)
+{
+	// a free voice that already has the sound skips SetSound
+	int32 freeVoice = INDEX_NONE;
+	for (int32 i = 0; i < Voices.Num(); i++)
+	{
+		if (!Voices[i].bActive)
+		{
+			if (Voices[i].Sound == Sound)
+			{
+				return i;
+			}
+			freeVoice = freeVoice == INDEX_NONE ? i : freeVoice;
+		}
+	}
+	if (freeVoice != INDEX_NONE)
+	{
+		return freeVoice;
+	}
+
+	FPS_LLM_SCOPE(CharacterGameplay);
+
+	if (!ProxyActor)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.Name = TEXT("GameplayAudioProxy");
+		spawnParams.ObjectFlags = RF_Transient;
+		ProxyActor = GetWorld()->SpawnActor<AActor>(spawnParams);
+	}
+
+	UAudioComponent* component = NewObject<UAudioComponent>(ProxyActor);
+	component->bAutoActivate = false;
+	component->bAutoDestroy = false;
+	component->bAllowSpatialization = true;
+	if (!ProxyActor->GetRootComponent())
+	{
+		ProxyActor->SetRootComponent(component);
+	}
+	component->RegisterComponent();
+
+	FGameplayAudioVoice& voice = Voices.AddDefaulted_GetRef();
+	voice.Component = component;
+	return Voices.Num() - 1;
+}
+
+void UGameplayAudioSubsystem::PlayVoice(int32 VoiceIndex, const FGameplayAudioRequest& Request, double Now)
+{
+	FGameplayAudioVoice& voice = Voices[VoiceIndex];
+	if (voice.Sound != Request.Sound)
+	{
+		voice.Component->SetSound(Request.Sound);
+		voice.Sound = Request.Sound;
+	}
+
+	// the merged requests play once at their average location, sqrt(N) is how loud N unrelated copies of a sound add up
+	const float volumeScale = FMath::Min(FMath::Sqrt((float)Request.Count), CVarAudioMaxMergedVolumeScale.GetValueOnGameThread());
+	voice.Component->SetWorldLocation(Request.LocationSum / Request.Count);
+	voice.Component->SetVolumeMultiplier(Request.VolumeMultiplier / Request.Count * volumeScale);
+	voice.Component->Play();
+
+	const float duration = Request.Sound->GetDuration();
+	const float maxDuration = CVarAudioMaxVoiceDuration.GetValueOnGameThread();
+	voice.EndTime = Now + (duration > 0.f && duration < maxDuration ? duration : maxDuration);
+	voice.Source = Request.Source;
+	voice.bActive = true;
+	NumPlayed++;
+}
+
+void UGameplayAudioSubsystem::FlushRequests()
+{
+	const double now = GetWorld()->GetAudioTimeSeconds();
+
+	NumActiveVoices = 0;
+	for (FGameplayAudioVoice& voice : Voices)
+	{
+		voice.bActive = voice.bActive && now < voice.EndTime;
+		NumActiveVoices += voice.bActive ? 1 : 0;
+	}
+
+	const int32 maxVoices = CVarAudioMaxVoices.GetValueOnGameThread();
+	const int32 maxVoicesPerSource = CVarAudioMaxVoicesPerSource.GetValueOnGameThread();
+
+	for (const FGameplayAudioRequest& request : Requests)
+	{
+		// a source over its budget restarts its oldest voice, rapid fire keeps the latest shot
+		const UObject* source = request.Source.Get();
+		if (source && maxVoicesPerSource > 0)
+		{
+			int32 numSourceVoices = 0;
+			int32 oldestVoice = INDEX_NONE;
+			for (int32 i = 0; i < Voices.Num(); i++)
+			{
+				const FGameplayAudioVoice& voice = Voices[i];
+				if (voice.bActive && voice.Source.Get() == source)
+				{
+					numSourceVoices++;
+					oldestVoice = oldestVoice == INDEX_NONE || voice.EndTime < Voices[oldestVoice].EndTime ? i : oldestVoice;
+				}
+			}
+
+			if (numSourceVoices >= maxVoicesPerSource)
+			{
+				PlayVoice(oldestVoice, request, now);
+				NumStolen++;
+				continue;
+			}
+		}
+
+		if (NumActiveVoices >= maxVoices)
+		{
+			NumDropped++;
+			continue;
+		}
+
+		PlayVoice(AcquireVoice(request.Sound), request, now);
+		NumActiveVoices++;
+	}
+
+	Requests.Reset();
+	RequestIndices.Reset();
+
+	NumFrames++;
+	PeakActiveVoices = FMath::Max(PeakActiveVoices, NumActiveVoices);
+	ActiveVoiceFrames += NumActiveVoices;
+}
+
+void UGameplayAudioSubsystem::ReportStats()
+{
+	UE_LOG(LogTemp, Display, TEXT("Gameplay audio: %d active voices, %d pooled components. Over %d frames: %d requests, %d played, %d merged, %d stolen, %d dropped, %.1f active voices per frame (peak %d)"),
+		NumActiveVoices, Voices.Num(), NumFrames, NumRequests, NumPlayed, NumMerged, NumStolen, NumDropped,
+		NumFrames > 0 ? (float)ActiveVoiceFrames / NumFrames : 0.f, PeakActiveVoices);
+
+	NumFrames = 0;
+	NumRequests = 0;
+	NumPlayed = 0;
+	NumMerged = 0;
+	NumStolen = 0;
+	NumDropped = 0;
+	PeakActiveVoices = 0;
+	ActiveVoiceFrames = 0;
+}
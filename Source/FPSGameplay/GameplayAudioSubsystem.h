@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameplayAudioSubsystem.generated.h"
+
+class UAudioComponent;
+class UGameplayAudioSubsystem;
+class USoundBase;
+
+/** A pooled audio component and the playback it's busy with */
+struct FGameplayAudioVoice
+{
+	UAudioComponent* Component = nullptr;
+	USoundBase* Sound = nullptr;
+	TWeakObjectPtr<const UObject> Source;
+
+	/** Game time the playback ends, the voice can be reused after it */
+	double EndTime = 0.0;
+	bool bActive = false;
+};
+
+/** Sounds requested this frame, merged by sound and merge cell */
+struct FGameplayAudioRequest
+{
+	USoundBase* Sound = nullptr;
+	/** Source of the first merged request, the playback counts against its voice budget */
+	TWeakObjectPtr<const UObject> Source;
+	FVector LocationSum = FVector::ZeroVector;
+	float VolumeMultiplier = 0.f;
+	int32 Count = 0;
+};
+
+/** Tick function that plays the requests of the frame */
+struct FGameplayAudioTickFunction : public FTickFunction
+{
+	UGameplayAudioSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Plays the gameplay one shot sounds from a pool of audio components instead of a new component per sound.
+ * The requests of a frame with the same sound in the same fps.Audio.MergeCellSize cell are merged into one playback
+ * with a louder volume, whatever source they come from,
+ * every source gets fps.Audio.MaxVoicesPerSource voices (the oldest one is restarted when it runs out)
+ * and the whole world fps.Audio.MaxVoices (the requests over it are dropped).
+ * The voices are tracked by the sound duration, so the budgets behave the same with -nosound or the null audio device.
+ * fps.Audio.Stats reports the voice counts and the merged, stolen and dropped requests.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGameplayAudioSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Queues a one shot sound, played with the other requests of the frame. Source is the actor the sound belongs to, for its voice budget */
+	void PlaySoundAtLocation(USoundBase* Sound, const FVector& Location, const UObject* Source, float VolumeMultiplier = 1.f);
+
+	/** Frees the finished voices and plays the queued requests */
+	void FlushRequests();
+
+	/** Voices playing right now */
+	int32 GetNumActiveVoices() const { return NumActiveVoices; }
+
+	/** Logs the counters since the last report and resets them */
+	void ReportStats();
+
+private:
+	/** Pooled voice to play Sound, creates one if every voice is busy */
+	int32 AcquireVoice(USoundBase* Sound);
+
+	/** Starts a playback on a voice */
+	void PlayVoice(int32 VoiceIndex, const FGameplayAudioRequest& Request, double Now);
+
+	UPROPERTY(Transient)
+		AActor* ProxyActor;
+
+	TArray<FGameplayAudioVoice> Voices;
+	TArray<FGameplayAudioRequest> Requests;
+
+	/** Request of every sound and merge cell queued this frame */
+	TMap<TPair<USoundBase*, FIntVector>, int32> RequestIndices;
+
+	FGameplayAudioTickFunction AudioTickFunction;
+
+	int32 NumActiveVoices = 0;
+
+	/** Counters since the last report */
+	int32 NumFrames = 0;
+	int32 NumRequests = 0;
+	int32 NumPlayed = 0;
+	int32 NumMerged = 0;
+	int32 NumStolen = 0;
+	int32 NumDropped = 0;
+	int32 PeakActiveVoices = 0;
+	int64 ActiveVoiceFrames = 0;
+};
@@ -0,0 +1,319 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GameplaySnapshotSubsystem.h"
+#include "FPSGameplayCharacter.h"
+#include "FPSGameplayProjectile.h"
+#include "GravityBall.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "Serialization/ArchiveProxy.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "FPSGameplayMemory.h"
+
+const FName UGameplaySnapshotSubsystem::DefaultSnapshotName(TEXT("Default"));
+
+static FAutoConsoleCommandWithWorldAndArgs SaveSnapshotCommand(
+	TEXT("fps.Snapshot.Save"),
+	TEXT("fps.Snapshot.Save [name]: saves the bodies, gravity balls, characters and projectiles of the level in memory"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UGameplaySnapshotSubsystem* snapshots = World->GetSubsystem<UGameplaySnapshotSubsystem>())
+		{
+			snapshots->SaveSnapshot(Args.Num() > 0 ? FName(*Args[0]) : UGameplaySnapshotSubsystem::DefaultSnapshotName);
+		}
+	}));
+
+static FAutoConsoleCommandWithWorldAndArgs RestoreSnapshotCommand(
+	TEXT("fps.Snapshot.Restore"),
+	TEXT("fps.Snapshot.Restore [name]: puts the level back in the state saved by fps.Snapshot.Save"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		if (UGameplaySnapshotSubsystem* snapshots = World->GetSubsystem<UGameplaySnapshotSubsystem>())
+		{
+			snapshots->RestoreSnapshot(Args.Num() > 0 ? FName(*Args[0]) : UGameplaySnapshotSubsystem::DefaultSnapshotName);
+		}
+	}));
+
+/** Writes object references as indices of the snapshot's object table, and reads them back */
+class FGameplaySnapshotArchive : public FArchiveProxy
+{
+public:
+	FGameplaySnapshotArchive(FArchive& InInnerArchive, FGameplaySnapshot& InSnapshot)
+		: FArchiveProxy(InInnerArchive)
+		, Snapshot(InSnapshot)
+	{
+	}
+
+	virtual FArchive& operator<<(UObject*& Object) override
+	{
+		int32 index = INDEX_NONE;
+		if (IsLoading())
+		{
+			InnerArchive << index;
+			Object = Snapshot.Objects.IsValidIndex(index) ? Snapshot.Objects[index].Get() : nullptr;
+		}
+		else
+		{
+			if (Object)
+			{
+				const int32* objectIndex = ObjectIndices.Find(Object);
+				index = objectIndex ? *objectIndex : ObjectIndices.Add(Object, Snapshot.Objects.Add(Object));
+			}
+			InnerArchive << index;
+		}
+		return *this;
+	}
+
+private:
+	FGameplaySnapshot& Snapshot;
+	TMap<UObject*, int32> ObjectIndices;
+};
+
+/** Serializes a typed object reference through the object table */
+template <typename ObjectType>
+static ObjectType* SerializeObject(FArchive& Ar, ObjectType* Object)
+{
+	UObject* object = Object;
+	Ar << object;
+	return Cast<ObjectType>(object);
+}
+
+/**
+ * The actor entries start with the offset they end at, so the entry of an actor destroyed since the save can be skipped.
+ * Saving returns where to write the offset once the entry is done, loading returns the offset
+ */
+static int64 BeginEntry(FArchive& Ar)
+{
+	const int64 entryStart = Ar.Tell();
+	int64 entryEnd = 0;
+	Ar << entryEnd;
+	return Ar.IsLoading() ? entryEnd : entryStart;
+}
+
+static void EndEntry(FArchive& Ar, int64 EntryStart)
+{
+	int64 entryEnd = Ar.Tell();
+	Ar.Seek(EntryStart);
+	Ar << entryEnd;
+	Ar.Seek(entryEnd);
+}
+
+void UGameplaySnapshotSubsystem::SaveSnapshot(FName Name)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	const double startTime = FPlatformTime::Seconds();
+	UWorld* world = GetWorld();
+
+	FGameplaySnapshot& snapshot = Snapshots.FindOrAdd(Name);
+	snapshot.Data.Reset();
+	snapshot.Objects.Reset();
+
+	FMemoryWriter writer(snapshot.Data);
+	FGameplaySnapshotArchive ar(writer, snapshot);
+
+	TArray<UPrimitiveComponent*> bodies;
+	TArray<AGravityBall*> balls;
+	TArray<AFPSGameplayCharacter*> characters;
+	TArray<AFPSGameplayProjectile*> projectiles;
+	for (TActorIterator<AActor> it(world); it; ++it)
+	{
+		if (AGravityBall* ball = Cast<AGravityBall>(*it))
+		{
+			balls.Add(ball);
+		}
+		else if (AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(*it))
+		{
+			characters.Add(character);
+		}
+		else if (AFPSGameplayProjectile* projectile = Cast<AFPSGameplayProjectile>(*it))
+		{
+			projectiles.Add(projectile);
+		}
+		else
+		{
+			it->ForEachComponent<UPrimitiveComponent>(false, [&bodies](UPrimitiveComponent* component)
+			{
+				if (component->IsSimulatingPhysics())
+				{
+					bodies.Add(component);
+				}
+			});
+		}
+	}
+
+	int32 numBodies = bodies.Num();
+	ar << numBodies;
+	for (UPrimitiveComponent* body : bodies)
+	{
+		FTransform transform = body->GetComponentTransform();
+		FVector linearVelocity = body->GetPhysicsLinearVelocity();
+		FVector angularVelocity = body->GetPhysicsAngularVelocityInDegrees();
+		bool bAwake = body->RigidBodyIsAwake();
+		SerializeObject(ar, body);
+		ar << transform << linearVelocity << angularVelocity << bAwake;
+	}
+
+	// the balls go before the characters, which restore the mode visuals of their ball
+	int32 numBalls = balls.Num();
+	ar << numBalls;
+	for (AGravityBall* ball : balls)
+	{
+		const int64 entryStart = BeginEntry(ar);
+		SerializeObject(ar, ball);
+		ball->SerializeSnapshot(ar);
+		EndEntry(ar, entryStart);
+	}
+
+	int32 numCharacters = characters.Num();
+	ar << numCharacters;
+	for (AFPSGameplayCharacter* character : characters)
+	{
+		const int64 entryStart = BeginEntry(ar);
+		SerializeObject(ar, character);
+		character->SerializeSnapshot(ar);
+		EndEntry(ar, entryStart);
+	}
+
+	int32 numProjectiles = projectiles.Num();
+	ar << numProjectiles;
+	for (AFPSGameplayProjectile* projectile : projectiles)
+	{
+		FTransform transform = projectile->GetActorTransform();
+		const int64 entryStart = BeginEntry(ar);
+		SerializeObject(ar, projectile);
+		SerializeObject(ar, projectile->GetClass());
+		ar << transform;
+		projectile->SerializeSnapshot(ar);
+		EndEntry(ar, entryStart);
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Snapshot %s saved: %d bodies, %d gravity balls, %d characters, %d projectiles in %d bytes, %.2f ms"),
+		*Name.ToString(), numBodies, numBalls, numCharacters, numProjectiles, snapshot.Data.Num(), (FPlatformTime::Seconds() - startTime) * 1000.0);
+}
+
+bool UGameplaySnapshotSubsystem::RestoreSnapshot(FName Name)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	FGameplaySnapshot* snapshot = Snapshots.Find(Name);
+	if (!snapshot)
+	{
+		UE_LOG(LogTemp, Warning, TEXT("There isn't a snapshot called %s, save one with fps.Snapshot.Save"), *Name.ToString());
+		return false;
+	}
+
+	const double startTime = FPlatformTime::Seconds();
+	UWorld* world = GetWorld();
+
+	FMemoryReader reader(snapshot->Data);
+	FGameplaySnapshotArchive ar(reader, *snapshot);
+
+	// objects destroyed since the save come back as null, their entries are read and skipped
+	int32 numBodies = 0;
+	ar << numBodies;
+	for (int32 i = 0; i < numBodies; i++)
+	{
+		FTransform transform;
+		FVector linearVelocity, angularVelocity;
+		bool bAwake = false;
+		UPrimitiveComponent* body = SerializeObject<UPrimitiveComponent>(ar, nullptr);
+		ar << transform << linearVelocity << angularVelocity << bAwake;
+
+		if (body && body->IsSimulatingPhysics())
+		{
+			body->SetWorldTransform(transform, false, nullptr, ETeleportType::TeleportPhysics);
+			body->SetPhysicsLinearVelocity(linearVelocity);
+			body->SetPhysicsAngularVelocityInDegrees(angularVelocity);
+			if (bAwake)
+			{
+				body->WakeRigidBody();
+			}
+			else
+			{
+				body->PutRigidBodyToSleep();
+			}
+		}
+	}
+
+	// the balls and characters can't be spawned again, the ones destroyed since are skipped
+	int32 numBalls = 0;
+	ar << numBalls;
+	for (int32 i = 0; i < numBalls; i++)
+	{
+		const int64 entryEnd = BeginEntry(ar);
+		if (AGravityBall* ball = SerializeObject<AGravityBall>(ar, nullptr))
+		{
+			ball->SerializeSnapshot(ar);
+		}
+		ar.Seek(entryEnd);
+	}
+
+	int32 numCharacters = 0;
+	ar << numCharacters;
+	for (int32 i = 0; i < numCharacters; i++)
+	{
+		const int64 entryEnd = BeginEntry(ar);
+		if (AFPSGameplayCharacter* character = SerializeObject<AFPSGameplayCharacter>(ar, nullptr))
+		{
+			character->SerializeSnapshot(ar);
+		}
+		ar.Seek(entryEnd);
+	}
+
+	// projectiles in the snapshot are moved back or spawned again, the ones fired since are destroyed
+	TSet<AFPSGameplayProjectile*> staleProjectiles;
+	for (TActorIterator<AFPSGameplayProjectile> it(world); it; ++it)
+	{
+		staleProjectiles.Add(*it);
+	}
+
+	int32 numProjectiles = 0;
+	int32 numSpawned = 0;
+	ar << numProjectiles;
+	for (int32 i = 0; i < numProjectiles; i++)
+	{
+		FTransform transform;
+		const int64 entryEnd = BeginEntry(ar);
+		AFPSGameplayProjectile* projectile = SerializeObject<AFPSGameplayProjectile>(ar, nullptr);
+		UClass* projectileClass = SerializeObject<UClass>(ar, nullptr);
+		ar << transform;
+
+		if (projectile && !projectile->IsPendingKill())
+		{
+			projectile->SetActorTransform(transform, false, nullptr, ETeleportType::TeleportPhysics);
+			staleProjectiles.Remove(projectile);
+		}
+		else if (projectileClass)
+		{
+			FActorSpawnParameters spawnParams;
+			spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+			projectile = world->SpawnActor<AFPSGameplayProjectile>(projectileClass, transform, spawnParams);
+			numSpawned += projectile ? 1 : 0;
+		}
+
+		if (projectile)
+		{
+			projectile->SerializeSnapshot(ar);
+		}
+		ar.Seek(entryEnd);
+	}
+
+	for (AFPSGameplayProjectile* projectile : staleProjectiles)
+	{
+		projectile->Destroy();
+	}
+
+	UE_LOG(LogTemp, Display, TEXT("Snapshot %s restored: %d bodies, %d gravity balls, %d characters, %d projectiles (%d spawned again, %d destroyed), %.2f ms"),
+		*Name.ToString(), numBodies, numBalls, numCharacters, numProjectiles, numSpawned, staleProjectiles.Num(), (FPlatformTime::Seconds() - startTime) * 1000.0);
+	return true;
+}
+
+void UGameplaySnapshotSubsystem::ClearSnapshots()
+{
+	Snapshots.Reset();
+}
@@ -0,0 +1,51 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GameplaySnapshotSubsystem.generated.h"
+
+/** One saved state of the level */
+struct FGameplaySnapshot
+{
+	/** Compact state of the bodies, gravity balls, characters and projectiles */
+	TArray<uint8> Data;
+
+	/** Objects referenced from Data, which stores their index */
+	TArray<TWeakObjectPtr<UObject>> Objects;
+};
+
+/**
+ * Saves the gameplay state of the level into memory and puts it back without reloading the map:
+ * the simulating bodies, the gravity balls, the characters' hook and ball timer, and the live projectiles.
+ * Every snapshot has a name, so they double as checkpoints to rewind to.
+ * Used with fps.Snapshot.Save [name] and fps.Snapshot.Restore [name].
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGameplaySnapshotSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Saves the current state under Name, replacing the snapshot with the same name */
+	UFUNCTION(BlueprintCallable, Category = Snapshot)
+		void SaveSnapshot(FName Name);
+
+	/**
+	 * Puts the level back in the state saved under Name. Projectiles fired since are destroyed and the destroyed ones spawned again.
+	 * @returns false if there isn't a snapshot with that name
+	 */
+	UFUNCTION(BlueprintCallable, Category = Snapshot)
+		bool RestoreSnapshot(FName Name);
+
+	/** Forgets every snapshot */
+	UFUNCTION(BlueprintCallable, Category = Snapshot)
+		void ClearSnapshots();
+
+	/** Snapshot used when the console commands don't get a name */
+	static const FName DefaultSnapshotName;
+
+private:
+	TMap<FName, FGameplaySnapshot> Snapshots;
+};
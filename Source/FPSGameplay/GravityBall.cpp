@@ -4,21 +4,75 @@
 #include "GravityBall.h"
 #include "GameFramework/Character.h"
 #include "GameFramework/CharacterMovementComponent.h"
+#include "GravityGunMovementComponent.h"
 #include "Math/UnrealMathUtility.h"
 #include "Components/StaticMeshComponent.h"
 #include "UProjectileMovementCompModified.h"
+#include "GravityMathConversions.h"
+#include "GravityFieldSubsystem.h"
+#include "FPSGameplayMemory.h"
+#include "GravityVisualsSubsystem.h"
+#include "GameplayAudioSubsystem.h"
+#include "CollisionEventQueueSubsystem.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Engine/World.h"
+#if WITH_FPS_CHAOS_FIELDS
+#include "Field/FieldSystemComponent.h"
+#include "Field/FieldSystemObjects.h"
+#endif
+
+const FName AGravityBall::GravityAreaVisualTag(TEXT("GravityAreaVisual"));
+const FName AGravityBall::GravityAreaVisualName(TEXT("GravityAreaOfEffectMesh"));
 
 // Sets default values
 AGravityBall::AGravityBall()
 {
+	FPS_LLM_SCOPE(GravitySystem);
+
 	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
 	PrimaryActorTick.bCanEverTick = true;
 
+	GravityFalloff = E_GravityFalloff::FALLOFF_LINEAR;
+	FalloffSofteningRadius = 50.f;
+	FalloffTableSize = 64;
+
+	SingularityStrength = 50000.f;
+	SingularityOpeningAngle = 0.5f;
+	SingularitySoftening = 50.f;
+
+	CanBodiesSleep = true;
+	SleepLinearSpeed = 5.f;
+	SleepAngularSpeed = 5.f;
+	SleepFrames = 30;
+	WakeDistance = 10.f;
+	MaxCatchUpScale = 8.f;
+	IsOcclusionEnabled = false;
+	OcclusionObjectType = ECC_WorldStatic;
+	OcclusionRetraceDistance = 50.f;
+	BodyCursor = 0;
+	BodiesLeftThisFrame = 0;
+	LastFieldLocation = FVector::ZeroVector;
+	LastFieldMode = E_GravityMode::MODE_ATTRACTION;
+	bLastFieldActive = false;
+	bLastAddedForces = false;
+	ChaosFieldReferenceMass = 100.f;
+	ChaosField = nullptr;
+	ChaosFieldLocation = FVector::ZeroVector;
+	ChaosFieldMode = E_GravityMode::MODE_ATTRACTION;
+	bChaosFieldActive = false;
+
+	AreaVisualActiveScale = 30.f;
+	ScaleAnimationDuration = 0.25f;
+	ColorBlendDuration = 0.3f;
+	ColorParameterName = TEXT("Color");
+	GravityModeSound = nullptr;
 }
 
 // Called when the game starts or when spawned
 void AGravityBall::BeginPlay()
 {
+	FPS_LLM_SCOPE(GravitySystem);
+
 	Super::BeginPlay();
 
 	GravityBallMesh_Component = FindComponentByClass<UStaticMeshComponent>();
@@ -38,8 +92,62 @@ void AGravityBall::BeginPlay()
 	}
 	else
 	{
-		GravityAreaTrigger->OnComponentBeginOverlap.AddDynamic(this, &AGravityBall::OnOverlapGravityBegin);
-		GravityAreaTrigger->OnComponentEndOverlap.AddDynamic(this, &AGravityBall::OnOverlapGravityEnd);
+		if (UCollisionEventQueueSubsystem* collisionQueue = GetWorld()->GetSubsystem<UCollisionEventQueueSubsystem>())
+		{
+			collisionQueue->RegisterComponent(GravityAreaTrigger, ECollisionHandlerType::GravityOverlap, FCollisionEventHandler::CreateUObject(this, &AGravityBall::OnGravityAreaEvent));
+		}
+	}
+
+	TInlineComponentArray<UStaticMeshComponent*> meshes(this);
+	for (UStaticMeshComponent* mesh : meshes)
+	{
+		if (mesh->ComponentHasTag(GravityAreaVisualTag) || (!GravityAreaVisual && mesh->GetFName() == GravityAreaVisualName))
+		{
+			GravityAreaVisual = mesh;
+		}
+	}
+	for (UStaticMeshComponent* mesh : meshes)
+	{
+		if (mesh != GravityAreaVisual)
+		{
+			BallMeshes.Add(mesh);
+			BallMeshScales.Add(mesh->GetRelativeScale3D());
+		}
+	}
+
+	BakeFalloffCurve();
+
+	if (UGravityFieldSubsystem* fields = GetWorld()->GetSubsystem<UGravityFieldSubsystem>())
+	{
+		fields->RegisterGravityBall(this);
+	}
+}
+
+void AGravityBall::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UCollisionEventQueueSubsystem* collisionQueue = GetWorld()->GetSubsystem<UCollisionEventQueueSubsystem>())
+	{
+		collisionQueue->UnregisterComponent(GravityAreaTrigger);
+	}
+
+	if (UGravityFieldSubsystem* fields = GetWorld()->GetSubsystem<UGravityFieldSubsystem>())
+	{
+		fields->UnregisterGravityBall(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGravityBall::BakeFalloffCurve()
+{
+	FalloffTable.Reset();
+	if (FalloffCurve && FalloffTableSize > 1)
+	{
+		FalloffTable.SetNumUninitialized(FalloffTableSize);
+		for (int32 i = 0; i < FalloffTableSize; i++)
+		{
+			FalloffTable[i] = FalloffCurve->GetFloatValue((float)i / (FalloffTableSize - 1));
+		}
 	}
 }
 
@@ -48,53 +156,484 @@ void AGravityBall::Tick(float DeltaTime)
 {
 	Super::Tick(DeltaTime);
 
-	ApplyGravityEffect(DeltaTime);
-
 	if (IsMovingForward)
 	{
 		MoveForward(DeltaTime);
 	}
 }
 
+/** Picks the falloff once for the whole batch so the kernel loop has no per body branches */
+template<bool bRepel>
+static void DispatchFalloffKernel(E_GravityFalloff Falloff, const GravityMath::FVec3* Locations, const float* Masses, int32 Count, const GravityMath::FVec3& BallLocation, float Force, float Radius, float Softening, const TArray<float>& Table, GravityMath::FVec3* OutForces)
+{
+	// without a baked curve fall back to the linear falloff
+	if (Falloff == E_GravityFalloff::FALLOFF_CURVE && Table.Num() == 0)
+	{
+		Falloff = E_GravityFalloff::FALLOFF_LINEAR;
+	}
+
+	switch (Falloff)
+	{
+	case E_GravityFalloff::FALLOFF_INVERSE_SQUARE:
+		GravityMath::RadialForceKernel<GravityMath::FInverseSquareFalloff, bRepel>(Locations, Masses, Count, BallLocation, Force, GravityMath::FInverseSquareFalloff{ Radius, Softening }, OutForces);
+		break;
+	case E_GravityFalloff::FALLOFF_CONSTANT:
+		GravityMath::RadialForceKernel<GravityMath::FConstantFalloff, bRepel>(Locations, Masses, Count, BallLocation, Force, GravityMath::FConstantFalloff{ Radius }, OutForces);
+		break;
+	case E_GravityFalloff::FALLOFF_CURVE:
+		GravityMath::RadialForceKernel<GravityMath::FTableFalloff, bRepel>(Locations, Masses, Count, BallLocation, Force, GravityMath::FTableFalloff{ Table.GetData(), Table.Num(), Radius }, OutForces);
+		break;
+	default:
+		GravityMath::RadialForceKernel<GravityMath::FLinearFalloff, bRepel>(Locations, Masses, Count, BallLocation, Force, GravityMath::FLinearFalloff{}, OutForces);
+		break;
+	}
+}
+
+void AGravityBall::ComputeGravityForces(int32 Count, float Radius)
+{
+	ScratchForces.SetNumUninitialized(Count, false);
+	const GravityMath::FVec3 ballLocation = ToGravityVec(GetActorLocation());
+
+	if (GravityMode == E_GravityMode::MODE_ATTRACTION)
+	{
+		DispatchFalloffKernel<false>(GravityFalloff, ScratchLocations.GetData(), ScratchMasses.GetData(), Count, ballLocation, AttractForce, Radius, FalloffSofteningRadius, FalloffTable, ScratchForces.GetData());
+	}
+	else
+	{
+		DispatchFalloffKernel<true>(GravityFalloff, ScratchLocations.GetData(), ScratchMasses.GetData(), Count, ballLocation, RepulsionForce, Radius, FalloffSofteningRadius, FalloffTable, ScratchForces.GetData());
+	}
+}
+
+void AGravityBall::WakeBodiesIfFieldChanged(bool bFieldActive)
+{
+	const FVector location = GetActorLocation();
+	if (bFieldActive == bLastFieldActive && GravityMode == LastFieldMode && FVector::DistSquared(location, LastFieldLocation) <= WakeDistance * WakeDistance)
+	{
+		return;
+	}
+
+	for (int32 i = 0; i < AffectedBodies.Num(); i++)
+	{
+		if (AffectedBodyStates[i].bSleptByField && AffectedBodies[i])
+		{
+			AffectedBodies[i]->WakeRigidBody();
+		}
+		AffectedBodyStates[i].bSleptByField = false;
+		AffectedBodyStates[i].RestFrames = 0;
+	}
+
+	LastFieldLocation = location;
+	LastFieldMode = GravityMode;
+	bLastFieldActive = bFieldActive;
+}
+
+#if WITH_FPS_CHAOS_FIELDS
+/** Closest stock radial falloff to each gravity falloff. The field falloffs decay from the center, the linear one grows towards the rim */
+static EFieldFalloffType ToChaosFalloff(E_GravityFalloff Falloff)
+{
+	switch (Falloff)
+	{
+	case E_GravityFalloff::FALLOFF_INVERSE_SQUARE:
+		return EFieldFalloffType::Field_Falloff_Squared;
+	case E_GravityFalloff::FALLOFF_CURVE:
+		return EFieldFalloffType::Field_Falloff_Linear;
+	default:
+		return EFieldFalloffType::Field_FallOff_None;
+	}
+}
+#endif
+
+void AGravityBall::UpdateChaosField(bool bFieldActive)
+{
+#if WITH_FPS_CHAOS_FIELDS
+	const FVector location = GetActorLocation();
+	if (bFieldActive == bChaosFieldActive && GravityMode == ChaosFieldMode && FVector::DistSquared(location, ChaosFieldLocation) <= WakeDistance * WakeDistance)
+	{
+		return;
+	}
+	ChaosFieldLocation = location;
+	ChaosFieldMode = GravityMode;
+	bChaosFieldActive = bFieldActive;
+
+	UFieldSystemComponent* field = Cast<UFieldSystemComponent>(ChaosField);
+	if (!field)
+	{
+		if (!bFieldActive)
+		{
+			return;
+		}
+		field = NewObject<UFieldSystemComponent>(this);
+		field->RegisterComponent();
+		ChaosField = field;
+	}
+
+	field->ResetFieldSystem();
+	if (UGravityFieldSubsystem* fields = GetWorld()->GetSubsystem<UGravityFieldSubsystem>())
+	{
+		fields->CountChaosFieldUpdate();
+	}
+	if (!bFieldActive)
+	{
+		return;
+	}
+
+	// radial direction times the falloff, with the kernel's force at the rim. Negative pulls towards the ball
+	const float radius = GravityAreaTrigger ? GravityAreaTrigger->GetScaledSphereRadius() : 1.f;
+	const bool bRepel = GravityMode != E_GravityMode::MODE_ATTRACTION;
+	const float magnitude = (bRepel ? RepulsionForce : -AttractForce) * radius * ChaosFieldReferenceMass;
+
+	URadialVector* direction = NewObject<URadialVector>(this);
+	direction->SetRadialVector(magnitude, location);
+
+	URadialFalloff* falloff = NewObject<URadialFalloff>(this);
+	falloff->SetRadialFalloff(1.f, 0.f, 1.f, 0.f, radius, location, ToChaosFalloff(GravityFalloff));
+
+	USumVector* force = NewObject<USumVector>(this);
+	force->SetSumVector(1.f, falloff, direction, nullptr, EFieldOperationType::Field_Multiply);
+
+	field->AddPersistentField(true, EFieldPhysicsType::Field_LinearForce, nullptr, force);
+#endif
+}
+
+void AGravityBall::BeginGravityUpdate()
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	const bool bFieldActive = IsGravityActive && GravityMode != E_GravityMode::MODE_HOOK;
+	WakeBodiesIfFieldChanged(bFieldActive);
+
+	// with the Chaos field the solver pushes the bodies, only the characters are left for the game thread.
+	// The field can't skip occluded bodies or pull them together, those balls keep AddForce
+	const bool bSingularity = IsSingularityMode && GravityMode == E_GravityMode::MODE_ATTRACTION;
+	const bool bChaosFields = UGravityFieldSubsystem::UsesChaosFields() && !IsOcclusionEnabled && !bSingularity;
+	UpdateChaosField(bFieldActive && bChaosFields);
+
+	// a pause of the field isn't load, the bodies get no catch up for it
+	const bool bAddsForces = bFieldActive && !bChaosFields;
+	if (bAddsForces && !bLastAddedForces)
+	{
+		const float now = GetWorld()->GetTimeSeconds();
+		for (FGravityBodyState& bodyState : AffectedBodyStates)
+		{
+			bodyState.LastUpdate = now;
+		}
+	}
+	bLastAddedForces = bAddsForces;
+
+	BodiesLeftThisFrame = bAddsForces ? AffectedBodies.Num() : 0;
+	if (!bFieldActive)
+	{
+		return;
+	}
+
+	// characters: same kernel, applied through their movement component. There are only a few of them and their
+	// movement isn't driven by physics, so they get their force every frame outside of the budget
+	const float radius = GravityAreaTrigger ? GravityAreaTrigger->GetScaledSphereRadius() : 1.f;
+	const FVector ballLocation = GetActorLocation();
+	for (int32 i = AffectedCharacterMovements.Num() - 1; i >= 0; i--)
+	{
+		if (!AffectedCharacterMovements[i])
+		{
+			AffectedCharacterMovements.RemoveAtSwap(i);
+			AffectedCharacterStates.RemoveAtSwap(i);
+		}
+	}
+
+	// shielded characters are skipped like the bodies, with the same async traces
+	ScratchLocations.Reset();
+	ScratchMasses.Reset();
+	ScratchBodyIndices.Reset();
+	for (int32 i = 0; i < AffectedCharacterMovements.Num(); i++)
+	{
+		UCharacterMovementComponent* move = AffectedCharacterMovements[i];
+		const FVector characterLocation = move->GetActorLocation();
+		if (IsOcclusionEnabled)
+		{
+			UpdateOcclusion(AffectedCharacterStates[i], i, characterLocation, ballLocation, PendingCharacterOcclusionTraces);
+			if (AffectedCharacterStates[i].bOccluded)
+			{
+				continue;
+			}
+		}
+
+		ScratchBodyIndices.Add(i);
+		ScratchLocations.Add(ToGravityVec(characterLocation));
+		ScratchMasses.Add(move->Mass);
+	}
+
+	if (PendingCharacterOcclusionTraces.Num() > 0)
+	{
+		IssueOcclusionTraces(ballLocation);
+	}
+
+	ComputeGravityForces(ScratchBodyIndices.Num(), radius);
+	for (int32 i = 0; i < ScratchBodyIndices.Num(); i++)
+	{
+		// gravity gun characters follow strong pulls in their own movement mode instead of fighting them while walking
+		UCharacterMovementComponent* move = AffectedCharacterMovements[ScratchBodyIndices[i]];
+		if (UGravityGunMovementComponent* gravityGunMovement = Cast<UGravityGunMovementComponent>(move))
+		{
+			gravityGunMovement->AddGravityPull(ToFVector(ScratchForces[i]));
+		}
+		else
+		{
+			move->AddForce(ToFVector(ScratchForces[i]));
+		}
+	}
+}
+
 /** Function that handles applying the gravity forces */
-void AGravityBall::ApplyGravityEffect(float DeltaTime)
+int32 AGravityBall::ApplyGravityEffect(float DeltaTime, int32 MaxBodies)
 {
-	if (IsGravityActive && GravityMode != E_GravityMode::MODE_HOOK)
+	FPS_LLM_SCOPE(GravitySystem);
+
+	// the mutual attraction needs every body in the same octree, the slice can't be split
+	if (IsSingularityMode && GravityMode == E_GravityMode::MODE_ATTRACTION)
 	{
-		for (int i = 0; i < AffectedActors.Num(); i++)
+		MaxBodies = BodiesLeftThisFrame;
+	}
+
+	const int32 numVisited = FMath::Min3(MaxBodies, BodiesLeftThisFrame, AffectedBodies.Num());
+	if (numVisited <= 0)
+	{
+		return 0;
+	}
+	BodiesLeftThisFrame -= numVisited;
+
+	const float radius = GravityAreaTrigger ? GravityAreaTrigger->GetScaledSphereRadius() : 1.f;
+	const float sleepLinearSpeedSquared = SleepLinearSpeed * SleepLinearSpeed;
+	const float sleepAngularSpeedSquared = SleepAngularSpeed * SleepAngularSpeed;
+	const float now = GetWorld()->GetTimeSeconds();
+	const FVector ballLocation = GetActorLocation();
+
+	// physics bodies: gather the simulating ones of the slice into packed arrays, run the kernel and apply the results
+	ScratchBodies.Reset();
+	ScratchLocations.Reset();
+	ScratchMasses.Reset();
+	ScratchBodyIndices.Reset();
+	for (int32 visited = 0; visited < numVisited; visited++)
+	{
+		const int32 i = BodyCursor;
+		BodyCursor = (BodyCursor + 1) % AffectedBodies.Num();
+
+		// only the bodies the budget deferred get a catch up, the ones skipped for any other reason start from now
+		FGravityBodyState& bodyState = AffectedBodyStates[i];
+		UStaticMeshComponent* body = AffectedBodies[i];
+		if (!body || !body->IsSimulatingPhysics())
 		{
-			FVector direction = AffectedActors[i]->GetActorLocation() - this->GetActorLocation();
+			bodyState.LastUpdate = now;
+			continue;
+		}
 
-			if (ACharacter* character = Cast<ACharacter>(AffectedActors[i]))
+		// bodies the field put to sleep are left alone, AddForce would wake them again.
+		// Awake again means something hit it, start counting from scratch
+		if (bodyState.bSleptByField)
+		{
+			if (CanBodiesSleep && !body->IsAnyRigidBodyAwake())
 			{
-				UCharacterMovementComponent* move = character->GetCharacterMovement();
-				if (GravityMode == E_GravityMode::MODE_ATTRACTION)
-				{
-					move->AddForce(-direction * AttractForce * move->Mass);
-				}
-				else
-				{
-					move->AddForce(direction * RepulsionForce * move->Mass);
-				}
+				bodyState.LastUpdate = now;
+				continue;
+			}
+			bodyState.bSleptByField = false;
+			bodyState.RestFrames = 0;
+		}
 
+		// a body that stays slow for a while with the field pulling on it is held by its contacts, let it sleep.
+		// Bodies asleep for any other reason get their force below, which wakes them into the field
+		if (CanBodiesSleep && body->IsAnyRigidBodyAwake())
+		{
+			const bool bResting = body->GetPhysicsLinearVelocity().SizeSquared() < sleepLinearSpeedSquared && body->GetPhysicsAngularVelocityInDegrees().SizeSquared() < sleepAngularSpeedSquared;
+			bodyState.RestFrames = bResting ? bodyState.RestFrames + 1 : 0;
+			if (bodyState.RestFrames >= SleepFrames)
+			{
+				body->PutRigidBodyToSleep();
+				bodyState.bSleptByField = true;
+				bodyState.LastUpdate = now;
+				continue;
 			}
-			else
+		}
+
+		// shielded bodies are skipped, the last known trace result is used until the new one comes back
+		const FVector bodyLocation = body->GetOwner()->GetActorLocation();
+		if (IsOcclusionEnabled)
+		{
+			UpdateOcclusion(bodyState, i, bodyLocation, ballLocation, PendingOcclusionTraces);
+			if (bodyState.bOccluded)
 			{
-				UStaticMeshComponent* actorMesh = Cast<UStaticMeshComponent>(AffectedActors[i]->FindComponentByClass<UStaticMeshComponent>());
-				if (actorMesh && actorMesh->IsSimulatingPhysics())
-				{
-					if (GravityMode == E_GravityMode::MODE_ATTRACTION)
-					{
-						actorMesh->AddForce(-direction * AttractForce * actorMesh->GetMass() );
-					}
-					else
-					{
-						actorMesh->AddForce(direction * RepulsionForce * actorMesh->GetMass() );
-					}
-				}
+				bodyState.LastUpdate = now;
+				continue;
 			}
 		}
+
+		ScratchBodies.Add(body);
+		ScratchBodyIndices.Add(i);
+		ScratchLocations.Add(ToGravityVec(bodyLocation));
+		ScratchMasses.Add(body->GetMass());
 	}
+
+	if (PendingOcclusionTraces.Num() > 0)
+	{
+		IssueOcclusionTraces(ballLocation);
+	}
+
+	ComputeGravityForces(ScratchBodies.Num(), radius);
+
+	// the bodies pull on each other too, the octree keeps it O(n log n)
+	if (IsSingularityMode && GravityMode == E_GravityMode::MODE_ATTRACTION && ScratchBodies.Num() > 1)
+	{
+		SingularityTree.Build(ScratchLocations.GetData(), ScratchMasses.GetData(), ScratchBodies.Num());
+		SingularityTree.AccumulateForces(SingularityStrength, SingularityOpeningAngle, SingularitySoftening, ScratchForces.GetData());
+	}
+
+	for (int32 i = 0; i < ScratchBodies.Num(); i++)
+	{
+		// bodies skipped by the scheduler get the force they missed, so the average pull doesn't depend on the load
+		FGravityBodyState& bodyState = AffectedBodyStates[ScratchBodyIndices[i]];
+		const float catchUpScale = DeltaTime > 0.f ? FMath::Clamp((now - bodyState.LastUpdate) / DeltaTime, 1.f, MaxCatchUpScale) : 1.f;
+		bodyState.LastUpdate = now;
+
+		ScratchBodies[i]->AddForce(ToFVector(ScratchForces[i]) * catchUpScale);
+	}
+
+	return numVisited;
+}
+
+void AGravityBall::UpdateOcclusion(FGravityBodyState& State, int32 Index, const FVector& TargetLocation, const FVector& BallLocation, TArray<int32>& Pending)
+{
+	UWorld* world = GetWorld();
+
+	if (State.OcclusionTrace.IsValid())
+	{
+		// async traces come back the frame after they're issued and are only kept for a frame,
+		// a body the scheduler didn't visit in time just gets traced again
+		FTraceDatum datum;
+		if (world->QueryTraceData(State.OcclusionTrace, datum))
+		{
+			State.bOccluded = datum.OutHits.Num() > 0 && datum.OutHits[0].bBlockingHit;
+			State.bTraced = true;
+			State.OcclusionTrace = FTraceHandle();
+		}
+		else if (world->IsTraceHandleValid(State.OcclusionTrace, false))
+		{
+			return;
+		}
+		else
+		{
+			State.OcclusionTrace = FTraceHandle();
+		}
+	}
+
+	const float retraceDistanceSquared = OcclusionRetraceDistance * OcclusionRetraceDistance;
+	if (!State.bTraced || FVector::DistSquared(TargetLocation, State.TracedBodyLocation) > retraceDistanceSquared || FVector::DistSquared(BallLocation, State.TracedBallLocation) > retraceDistanceSquared)
+	{
+		Pending.Add(Index);
+	}
+}
+
+void AGravityBall::IssueOcclusionTraces(const FVector& BallLocation)
+{
+	UGravityFieldSubsystem* fields = GetWorld()->GetSubsystem<UGravityFieldSubsystem>();
+	const int32 numPending = PendingCharacterOcclusionTraces.Num() + PendingOcclusionTraces.Num();
+	const int32 numTraces = fields ? fields->ClaimOcclusionTraces(numPending) : numPending;
+
+	// the characters come first, there are only a few and they're the ones a wrong pull shows on
+	const FCollisionObjectQueryParams objectParams(OcclusionObjectType);
+	for (int32 i = 0; i < numTraces; i++)
+	{
+		const bool bCharacter = i < PendingCharacterOcclusionTraces.Num();
+		const int32 index = bCharacter ? PendingCharacterOcclusionTraces[i] : PendingOcclusionTraces[i - PendingCharacterOcclusionTraces.Num()];
+		AActor* targetActor = bCharacter ? AffectedCharacterMovements[index]->GetOwner() : AffectedBodies[index]->GetOwner();
+
+		FCollisionQueryParams queryParams(SCENE_QUERY_STAT(GravityOcclusion), false, this);
+		queryParams.AddIgnoredActor(targetActor);
+
+		FGravityBodyState& bodyState = bCharacter ? AffectedCharacterStates[index] : AffectedBodyStates[index];
+		bodyState.TracedBallLocation = BallLocation;
+		bodyState.TracedBodyLocation = targetActor->GetActorLocation();
+		bodyState.OcclusionTrace = GetWorld()->AsyncLineTraceByObjectType(EAsyncTraceType::Single, BallLocation, bodyState.TracedBodyLocation, objectParams, queryParams);
+	}
+
+	PendingCharacterOcclusionTraces.Reset();
+	PendingOcclusionTraces.Reset();
+}
+
+void AGravityBall::PlayGravityModeVisuals(UMaterialInstance* material)
+{
+#if WITH_FPS_COSMETICS
+	if (GravityModeSound)
+	{
+		if (UGameplayAudioSubsystem* gameplayAudio = GetWorld()->GetSubsystem<UGameplayAudioSubsystem>())
+		{
+			gameplayAudio->PlaySoundAtLocation(GravityModeSound, GetActorLocation(), this);
+		}
+	}
+
+	UPrimitiveComponent* target = GravityAreaVisual ? GravityAreaVisual : GravityBallMesh_Component;
+	if (!material || !target)
+	{
+		return;
+	}
+
+	// materials without the color parameter can't be blended, swap them directly
+	FLinearColor targetColor;
+	if (!material->GetVectorParameterValue(FHashedMaterialParameterInfo(ColorParameterName), targetColor))
+	{
+		target->SetMaterial(0, material);
+		GravityAreaMaterial = nullptr;
+		return;
+	}
+
+	// blend from wherever the previous blend got to
+	FLinearColor currentColor = targetColor;
+	if (GravityAreaMaterial)
+	{
+		GravityAreaMaterial->GetVectorParameterValue(FHashedMaterialParameterInfo(ColorParameterName), currentColor);
+	}
+
+	// the whole material of the new mode is used, only its color is blended
+	UMaterialInstanceDynamic*& modeMaterial = GravityAreaModeMaterials.FindOrAdd(material);
+	if (!modeMaterial)
+	{
+		modeMaterial = UMaterialInstanceDynamic::Create(material, this);
+	}
+	GravityAreaMaterial = modeMaterial;
+	target->SetMaterial(0, GravityAreaMaterial);
+
+	if (UGravityVisualsSubsystem* visuals = GetWorld()->GetSubsystem<UGravityVisualsSubsystem>())
+	{
+		visuals->PlayColorBlend(GravityAreaMaterial, ColorParameterName, currentColor, targetColor, ColorBlendDuration, ColorBlendCurve);
+	}
+#endif
+}
+
+void AGravityBall::PlayAreaOfGravityScale(bool dissapear)
+{
+#if WITH_FPS_COSMETICS
+	if (!GravityAreaVisual)
+	{
+		return;
+	}
+
+	if (UGravityVisualsSubsystem* visuals = GetWorld()->GetSubsystem<UGravityVisualsSubsystem>())
+	{
+		const FVector from = dissapear ? GravityAreaVisual->GetRelativeScale3D() : FVector::ZeroVector;
+		visuals->PlayScale(GravityAreaVisual, from, dissapear ? FVector::ZeroVector : FVector(AreaVisualActiveScale), ScaleAnimationDuration, ScaleAnimationCurve);
+	}
+#endif
+}
+
+void AGravityBall::PlayGravityBallScale(bool dissapear)
+{
+#if WITH_FPS_COSMETICS
+	if (UGravityVisualsSubsystem* visuals = GetWorld()->GetSubsystem<UGravityVisualsSubsystem>())
+	{
+		for (int32 i = 0; i < BallMeshes.Num(); i++)
+		{
+			const FVector from = dissapear ? BallMeshes[i]->GetRelativeScale3D() : FVector::ZeroVector;
+			visuals->PlayScale(BallMeshes[i], from, dissapear ? FVector::ZeroVector : BallMeshScales[i], ScaleAnimationDuration, ScaleAnimationCurve);
+		}
+	}
+#endif
 }
 
 /** Called when the ball is moving forward */
@@ -129,7 +668,7 @@ void AGravityBall::StopMoving()
 {
 	IsMovingForward = false;
 	IsGravityActive = true;
-	ResizeAreaOfGravity(false);
+	PlayAreaOfGravityScale(false);
 }
 
 void AGravityBall::ReturnBall()
@@ -147,14 +686,73 @@ void AGravityBall::ReturnBall()
 		SetActorLocation(SpawnLocation);
 		SetActorRotation(SpawnRotation);
 		AttachToComponent(AttachToGunComponent, FAttachmentTransformRules::KeepWorldTransform);
-		AppearDissapearGravityBall(false);
+		PlayGravityBallScale(false);
 	}
 	
 }
 
+void AGravityBall::SerializeSnapshot(FArchive& Ar)
+{
+	const bool bWasDettached = IsDettached;
+	FTransform transform = GetActorTransform();
+	Ar << GravityMode << IsGravityActive << IsDettached << IsMovingForward << transform;
+
+	if (!Ar.IsLoading())
+	{
+		return;
+	}
+
+	if (IsDettached && !bWasDettached)
+	{
+		DetachFromActor(FDetachmentTransformRules::KeepWorldTransform);
+	}
+	else if (!IsDettached && bWasDettached && AttachToGunComponent)
+	{
+		AttachToComponent(AttachToGunComponent, FAttachmentTransformRules::KeepWorldTransform);
+	}
+	SetActorTransform(transform, false, nullptr, ETeleportType::TeleportPhysics);
+
+	// the restored bodies already sleep or not for this field, it mustn't look like it changed
+	LastFieldLocation = GetActorLocation();
+	LastFieldMode = GravityMode;
+	bLastFieldActive = IsGravityActive && GravityMode != E_GravityMode::MODE_HOOK;
+	bLastAddedForces = false;
+
+#if WITH_FPS_COSMETICS
+	// snap the visuals to the restored state, cutting the animations that were playing
+	if (UGravityVisualsSubsystem* visuals = GetWorld()->GetSubsystem<UGravityVisualsSubsystem>())
+	{
+		for (int32 i = 0; i < BallMeshes.Num(); i++)
+		{
+			visuals->PlayScale(BallMeshes[i], BallMeshScales[i], BallMeshScales[i], 0.f);
+		}
+		const FVector areaScale = IsGravityActive ? FVector(AreaVisualActiveScale) : FVector::ZeroVector;
+		visuals->PlayScale(GravityAreaVisual, areaScale, areaScale, 0.f);
+	}
+#endif
+}
+
+void AGravityBall::OnGravityAreaEvent(const FCollisionQueueEvent& Event)
+{
+	if (Event.Kind == ECollisionEventKind::BeginOverlap)
+	{
+		OnOverlapGravityBegin(Event);
+	}
+	else if (Event.Kind == ECollisionEventKind::EndOverlap)
+	{
+		OnOverlapGravityEnd(Event);
+	}
+}
+
 /** called when something enters in the gravity area */
-void AGravityBall::OnOverlapGravityBegin(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+void AGravityBall::OnOverlapGravityBegin(const FCollisionQueueEvent& Event)
 {
+	FPS_LLM_SCOPE(GravitySystem);
+	FPS_ALLOC_SCOPE(GravityOverlap);
+
+	AActor* OtherActor = Event.GetOtherActor();
+	UPrimitiveComponent* OtherComp = Event.GetOtherComponent();
+
 	// Other Actor is the actor that triggered the event. Check that is not ourself.  
 	if ((OtherActor != nullptr) && (OtherActor != this) && (OtherComp != nullptr))
 	{
@@ -182,13 +780,33 @@ void AGravityBall::OnOverlapGravityBegin(UPrimitiveComponent* OverlappedComp, AA
 		else
 		{
 			AffectedActors.Add(OtherActor);
+
+			// sort the new actor by the way the force is applied to it, so the gravity update doesn't need to branch per actor
+			if (ACharacter* character = Cast<ACharacter>(OtherActor))
+			{
+				if (UCharacterMovementComponent* move = character->GetCharacterMovement())
+				{
+					AffectedCharacterMovements.Add(move);
+					AffectedCharacterStates.AddDefaulted();
+				}
+			}
+			else if (UStaticMeshComponent* actorMesh = OtherActor->FindComponentByClass<UStaticMeshComponent>())
+			{
+				AffectedBodies.Add(actorMesh);
+				AffectedBodyStates.AddDefaulted_GetRef().LastUpdate = GetWorld()->GetTimeSeconds();
+			}
 		}
 	}
 }
 
 /** called when something leaves the gravity area */
-void AGravityBall::OnOverlapGravityEnd(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+void AGravityBall::OnOverlapGravityEnd(const FCollisionQueueEvent& Event)
 {
+	FPS_ALLOC_SCOPE(GravityOverlap);
+
+	AActor* OtherActor = Event.GetOtherActor();
+	UPrimitiveComponent* OtherComp = Event.GetOtherComponent();
+
 	// Other Actor is the actor that triggered the event. Check that is not ourself.  
 	if ((OtherActor != nullptr) && (OtherActor != this) && (OtherComp != nullptr))
 	{
@@ -201,6 +819,30 @@ void AGravityBall::OnOverlapGravityEnd(UPrimitiveComponent* OverlappedComp, AAct
 				AffectedProjectiles.Remove(projectile);
 			}
 		}
-		AffectedActors.Remove(OtherActor);
+		if (AffectedActors.Remove(OtherActor) > 0)
+		{
+			if (ACharacter* character = Cast<ACharacter>(OtherActor))
+			{
+				const int32 characterIndex = AffectedCharacterMovements.Find(character->GetCharacterMovement());
+				if (characterIndex != INDEX_NONE)
+				{
+					AffectedCharacterMovements.RemoveAt(characterIndex);
+					AffectedCharacterStates.RemoveAt(characterIndex);
+				}
+			}
+			else
+			{
+				UStaticMeshComponent* actorMesh = OtherActor->FindComponentByClass<UStaticMeshComponent>();
+				for (int32 i = AffectedBodies.Num() - 1; i >= 0; i--)
+				{
+					if (AffectedBodies[i] == actorMesh)
+					{
+						AffectedBodies.RemoveAt(i);
+						AffectedBodyStates.RemoveAt(i);
+					}
+				}
+				BodyCursor = AffectedBodies.Num() > 0 ? BodyCursor % AffectedBodies.Num() : 0;
+			}
+		}
 	}
 }
\ No newline at end of file
@@ -8,6 +8,10 @@
 #include "Components/SphereComponent.h"
 #include "FPSGameplayProjectile.h"
 #include "Materials/MaterialInstance.h"
+#include "Curves/CurveFloat.h"
+#include "WorldCollision.h"
+#include "GravityMath.h"
+#include "BarnesHut.h"
 #include "GravityBall.generated.h"
 
 /** Enum for the different modes of the gravity ball */
@@ -19,6 +23,38 @@ enum class E_GravityMode : uint8
 	MODE_HOOK	UMETA(DisplayName = "Hook")
 };
 
+/** Enum for the different ways the gravity force changes with the distance to the ball */
+UENUM(BlueprintType)
+enum class E_GravityFalloff : uint8
+{
+	FALLOFF_LINEAR = 0	UMETA(DisplayName = "Linear"),
+	FALLOFF_INVERSE_SQUARE	UMETA(DisplayName = "Inverse Square"),
+	FALLOFF_CONSTANT	UMETA(DisplayName = "Constant"),
+	FALLOFF_CURVE	UMETA(DisplayName = "Curve")
+};
+
+/** Per body state of a gravity field */
+struct FGravityBodyState
+{
+	/** Consecutive frames the body has been resting */
+	int32 RestFrames = 0;
+
+	/** The field put the body to sleep, it gets no force until something wakes it or the field changes */
+	bool bSleptByField = false;
+
+	/** World time the body last got its force */
+	float LastUpdate = 0.f;
+
+	/** Result of the last occlusion trace, and the ball and body locations it was traced between */
+	bool bOccluded = false;
+	bool bTraced = false;
+	FVector TracedBallLocation = FVector::ZeroVector;
+	FVector TracedBodyLocation = FVector::ZeroVector;
+
+	/** Occlusion trace in flight */
+	FTraceHandle OcclusionTrace;
+};
+
 UCLASS()
 class FPSGAMEPLAY_API AGravityBall : public AActor
 {
@@ -32,13 +68,17 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+	// Called when the game ends or when destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	/** called when something enters in the gravity area */
-	UFUNCTION()
-		void OnOverlapGravityBegin(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+	void OnOverlapGravityBegin(const struct FCollisionQueueEvent& Event);
 
 	/** called when something leaves the gravity area */
-	UFUNCTION()
-		void OnOverlapGravityEnd(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+	void OnOverlapGravityEnd(const struct FCollisionQueueEvent& Event);
+
+	/** Sends the queued overlap events of the gravity area to OnOverlapGravityBegin/End */
+	void OnGravityAreaEvent(const struct FCollisionQueueEvent& Event);
 public:
 
 	/** True if the gravity attraction/repulsion is activated */
@@ -61,6 +101,74 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
 		E_GravityMode GravityMode;
 
+	/** How the force changes with the distance to the ball */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		E_GravityFalloff GravityFalloff;
+
+	/** Softening radius for the inverse square falloff, keeps the force finite close to the center */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float FalloffSofteningRadius;
+
+	/** Curve used by the curve falloff. X is the normalized distance to the center (0-1), Y the force scale at the rim */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		UCurveFloat* FalloffCurve;
+
+	/** Number of samples the falloff curve is baked into */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		int32 FalloffTableSize;
+
+	/** Singularity mode: in attraction mode the bodies in the area also attract each other */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		bool IsSingularityMode;
+
+	/** Strength of the mutual attraction between bodies in singularity mode */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float SingularityStrength;
+
+	/** Barnes-Hut opening angle. Lower is more accurate and more expensive, 0 computes every pair */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity, meta = (ClampMin = "0.0", ClampMax = "2.0"))
+		float SingularityOpeningAngle;
+
+	/** Keeps the mutual attraction finite when two bodies touch, at least 1 so overlapping bodies never divide by zero */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity, meta = (ClampMin = "1.0"))
+		float SingularitySoftening;
+
+	/** Lets the bodies that came to rest in the field fall asleep. They are woken when the ball moves, the mode changes or something disturbs them */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		bool CanBodiesSleep;
+
+	/** Linear speed under which a body in the field counts as resting */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float SleepLinearSpeed;
+
+	/** Angular speed (deg/s) under which a body in the field counts as resting */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float SleepAngularSpeed;
+
+	/** Consecutive resting frames before a body is put to sleep */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		int32 SleepFrames;
+
+	/** The sleeping bodies are woken when the ball moves more than this */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float WakeDistance;
+
+	/** Highest multiplier applied to the force of a body the scheduler couldn't update for several frames */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float MaxCatchUpScale;
+
+	/** Walls block the field: bodies without line of sight to the ball aren't affected. Checked with async traces */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		bool IsOcclusionEnabled;
+
+	/** Object type that blocks the field. Static geometry by default, so the bodies in the field don't shield each other */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		TEnumAsByte<ECollisionChannel> OcclusionObjectType;
+
+	/** A body is traced again when it or the ball moved more than this since its last trace */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float OcclusionRetraceDistance;
+
 	/** Array of objects that are in the orbit of the gravity ball */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
 		TArray <AActor*> AffectedActors;
@@ -73,6 +181,10 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
 		float movementSpeed;
 
+	/** With fps.Gravity.ChaosFields the field forces don't scale with the mass of the bodies: they're the kernel's force on a body this heavy */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gravity)
+		float ChaosFieldReferenceMass;
+
 	/** Max distance to the player for the ball to stop moving */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Movement)
 		float maxDistanceToplayer;
@@ -101,25 +213,92 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Components)
 		class USphereComponent* GravityAreaTrigger;
 
-	/** Changes the color of the gravity effect */
-	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall)
+	/** Mesh that shows the gravity area, the static mesh component tagged GravityAreaVisualTag or called GravityAreaVisualName */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Components)
+		class UStaticMeshComponent* GravityAreaVisual;
+
+	/** Components tagged with this are used as GravityAreaVisual */
+	static const FName GravityAreaVisualTag;
+
+	/** Name of the area mesh in GravityBall_BP, used when no component has the tag */
+	static const FName GravityAreaVisualName;
+
+	/** Uniform scale of the area mesh when the gravity is active */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		float AreaVisualActiveScale;
+
+	/** Shape of the appear/disappear animations. X is the normalized time, Y the blend alpha. Linear if not set */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		UCurveFloat* ScaleAnimationCurve;
+
+	/** Length of the appear/disappear animations of the ball and its area */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		float ScaleAnimationDuration;
+
+	/** Shape of the color blend when the mode changes. Linear if not set */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		UCurveFloat* ColorBlendCurve;
+
+	/** Length of the color blend when the mode changes */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		float ColorBlendDuration;
+
+	/** Vector parameter of the gravity materials blended when the mode changes */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		FName ColorParameterName;
+
+	/** Sound played when the gravity mode changes, through the pooled gameplay audio */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Visuals)
+		class USoundBase* GravityModeSound;
+
+	/** Switches the area to the material of the new mode, blending its color from the previous one */
+	UFUNCTION(BlueprintCallable, Category = Visuals)
+		void PlayGravityModeVisuals(UMaterialInstance* material);
+
+	/** Scales the gravity area mesh in or out */
+	UFUNCTION(BlueprintCallable, Category = Visuals)
+		void PlayAreaOfGravityScale(bool dissapear);
+
+	/** Scales the ball meshes in or out */
+	UFUNCTION(BlueprintCallable, Category = Visuals)
+		void PlayGravityBallScale(bool dissapear);
+
+	/**
+	 * Former Blueprint animation hooks, not called anymore: the animations above play natively.
+	 * Declared until the overrides are deleted from GravityBall_BP, which doesn't compile without them
+	 */
+	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall, meta = (DeprecatedFunction, DeprecationMessage = "Not called anymore, PlayGravityModeVisuals does it natively. Delete the override"))
 		void ChangeGravityMaterial(UMaterialInstance* material);
 
-	/** Function makes a little resize animation for the ball gravity area */
-	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall)
+	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall, meta = (DeprecatedFunction, DeprecationMessage = "Not called anymore, PlayAreaOfGravityScale does it natively. Delete the override"))
 		void ResizeAreaOfGravity(bool dissapear);
 
-	/** Function makes a little resize animation for the ball when it disapears/appears */
-	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall)
+	UFUNCTION(BlueprintImplementableEvent, Category = GravityBall, meta = (DeprecatedFunction, DeprecationMessage = "Not called anymore, PlayGravityBallScale does it natively. Delete the override"))
 		void AppearDissapearGravityBall(bool dissapear);
 
 	/** Function makes a little resize animation for the ball when it disapears/appears */
 	UFUNCTION(BlueprintCallable, Category = GravityBall)
 		void ReturnBall();
 
-	/** Function that handles applying the gravity forces */
-	UFUNCTION()
-		void ApplyGravityEffect(float DeltaTime);
+	/** Saves or restores the mode, the active, detached and moving flags and the transform, for UGameplaySnapshotSubsystem */
+	void SerializeSnapshot(FArchive& Ar);
+
+	/** Bakes FalloffCurve into the lookup table used by the curve falloff. Call it again after changing the curve at runtime */
+	UFUNCTION(BlueprintCallable, Category = Gravity)
+		void BakeFalloffCurve();
+
+	/** Starts the gravity update of this frame: wakes the sleeping bodies if needed and applies the force to the characters */
+	void BeginGravityUpdate();
+
+	/**
+	 * Function that handles applying the gravity forces. Called by UGravityFieldSubsystem, which spreads the bodies over several frames when it's over budget.
+	 * @param MaxBodies		bodies to visit in this call, continuing where the previous call stopped
+	 * @returns the number of bodies visited
+	 */
+	int32 ApplyGravityEffect(float DeltaTime, int32 MaxBodies);
+
+	/** Bodies that haven't been visited since BeginGravityUpdate */
+	int32 GetBodiesLeftThisFrame() const { return BodiesLeftThisFrame; }
 
 	/** Called when the ball is moving forward */
 	UFUNCTION()
@@ -136,4 +315,86 @@ public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
 
+protected:
+	/** Physics bodies of the affected actors that aren't characters, kept in sync with AffectedActors */
+	UPROPERTY(Transient)
+		TArray<UStaticMeshComponent*> AffectedBodies;
+
+	/** Field side state of each of AffectedBodies */
+	TArray<FGravityBodyState> AffectedBodyStates;
+
+	/** Reads the finished occlusion trace of a body or character and queues a new one in Pending if it moved, within the frame's trace budget */
+	void UpdateOcclusion(FGravityBodyState& State, int32 Index, const FVector& TargetLocation, const FVector& BallLocation, TArray<int32>& Pending);
+
+	/** Bodies waiting for an occlusion trace, issued in one batch at the end of ApplyGravityEffect */
+	TArray<int32> PendingOcclusionTraces;
+
+	/** Characters waiting for an occlusion trace, issued before the bodies */
+	TArray<int32> PendingCharacterOcclusionTraces;
+
+	/** Issues the queued occlusion traces the frame's budget allows, the rest wait for their next visit */
+	void IssueOcclusionTraces(const FVector& BallLocation);
+
+	/** Next body ApplyGravityEffect visits, and how many are left to visit this frame */
+	int32 BodyCursor;
+	int32 BodiesLeftThisFrame;
+
+	/** State of the field the last frame, the sleeping bodies are woken when it changes */
+	FVector LastFieldLocation;
+	E_GravityMode LastFieldMode;
+	bool bLastFieldActive;
+
+	/** True if the bodies got their force through AddForce last frame. When it starts again their catch up starts from scratch */
+	bool bLastAddedForces;
+
+	/** Wakes the bodies put to sleep by the field if the ball moved, changed mode or was switched on/off */
+	void WakeBodiesIfFieldChanged(bool bFieldActive);
+
+	/** Field system component that pushes the bodies in the Chaos solver, created the first time fps.Gravity.ChaosFields needs it */
+	UPROPERTY(Transient)
+		class UActorComponent* ChaosField;
+
+	/** State the Chaos field was last built with */
+	FVector ChaosFieldLocation;
+	E_GravityMode ChaosFieldMode;
+	bool bChaosFieldActive;
+
+	/** Rebuilds the Chaos field when the ball moved, changed mode or was switched on/off. Does nothing in the other frames */
+	void UpdateChaosField(bool bFieldActive);
+
+	/** Movement components of the affected characters, kept in sync with AffectedActors */
+	UPROPERTY(Transient)
+		TArray<class UCharacterMovementComponent*> AffectedCharacterMovements;
+
+	/** Occlusion state of each of AffectedCharacterMovements */
+	TArray<FGravityBodyState> AffectedCharacterStates;
+
+	/** Falloff curve baked by BakeFalloffCurve */
+	TArray<float> FalloffTable;
+
+	/** Scratch buffers reused every frame by ApplyGravityEffect so the kernels work on packed data */
+	TArray<GravityMath::FVec3> ScratchLocations;
+	TArray<float> ScratchMasses;
+	TArray<GravityMath::FVec3> ScratchForces;
+	TArray<UStaticMeshComponent*> ScratchBodies;
+	TArray<int32> ScratchBodyIndices;
+
+	/** Octree rebuilt every frame from the affected bodies in singularity mode */
+	GravityMath::FBarnesHutTree SingularityTree;
+
+	/** Runs the kernel picked for the current mode and falloff over the scratch buffers */
+	void ComputeGravityForces(int32 Count, float Radius);
+
+	/** Meshes of the ball itself, every static mesh but the area, with their scales when fully visible */
+	UPROPERTY(Transient)
+		TArray<class UStaticMeshComponent*> BallMeshes;
+	TArray<FVector> BallMeshScales;
+
+	/** Dynamic instance of the current mode's area material, the color blends run on it */
+	UPROPERTY(Transient)
+		class UMaterialInstanceDynamic* GravityAreaMaterial;
+
+	/** Dynamic instance of every mode material used so far, made once so a mode change doesn't allocate */
+	UPROPERTY(Transient)
+		TMap<class UMaterialInterface*, class UMaterialInstanceDynamic*> GravityAreaModeMaterials;
 };
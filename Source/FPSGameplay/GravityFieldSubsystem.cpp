@@ -0,0 +1,247 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityFieldSubsystem.h"
+#include "GravityBall.h"
+#include "Engine/World.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/CollisionProfile.h"
+#include "Components/StaticMeshComponent.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "FPSGameplayMemory.h"
+
+static TAutoConsoleVariable<float> CVarGravityFrameBudgetMs(
+	TEXT("fps.Gravity.FrameBudgetMs"),
+	1.f,
+	TEXT("Milliseconds per frame the gravity of all the balls can take. Bodies that don't fit are updated in the next frames. 0 disables the budget"));
+
+static TAutoConsoleVariable<int32> CVarGravityBatchSize(
+	TEXT("fps.Gravity.BatchSize"),
+	32,
+	TEXT("Bodies processed between two checks of the gravity frame budget"));
+
+static TAutoConsoleVariable<int32> CVarGravityOcclusionTraceBudget(
+	TEXT("fps.Gravity.OcclusionTraceBudget"),
+	64,
+	TEXT("Occlusion traces all the gravity balls can issue per frame. The bodies that don't fit keep their last result"));
+
+static TAutoConsoleVariable<int32> CVarGravityChaosFields(
+	TEXT("fps.Gravity.ChaosFields"),
+	0,
+	TEXT("1 pushes the bodies with a radial force field per ball evaluated by the Chaos solver, instead of AddForce per body. Only in WITH_FPS_CHAOS_FIELDS builds"));
+
+static FAutoConsoleCommandWithWorld GravitySchedulerStatsCommand(
+	TEXT("fps.Gravity.SchedulerStats"),
+	TEXT("Logs the gravity scheduler time, budget overruns and backlog since the last call"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UGravityFieldSubsystem* fields = World->GetSubsystem<UGravityFieldSubsystem>())
+		{
+			fields->ReportSchedulerStats();
+		}
+	}));
+
+/** Tag of the bodies spawned by fps.Gravity.FieldBenchmark */
+static const FName GravityBenchmarkTag(TEXT("GravityBenchmark"));
+
+static FAutoConsoleCommandWithWorldAndArgs GravityFieldBenchmarkCommand(
+	TEXT("fps.Gravity.FieldBenchmark"),
+	TEXT("fps.Gravity.FieldBenchmark <count>: spawns count physics cubes in the area of the first active gravity ball, 0 removes them. ")
+	TEXT("Compare fps.Gravity.SchedulerStats and stat unit with fps.Gravity.ChaosFields 0 and 1"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		for (TActorIterator<AStaticMeshActor> it(World); it; ++it)
+		{
+			if (it->ActorHasTag(GravityBenchmarkTag))
+			{
+				it->Destroy();
+			}
+		}
+
+		const int32 count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1000;
+		UGravityFieldSubsystem* fields = World->GetSubsystem<UGravityFieldSubsystem>();
+		UStaticMesh* cube = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+		if (count <= 0 || !fields || !cube)
+		{
+			return;
+		}
+
+		const AGravityBall* const* activeBall = fields->GetGravityBalls().FindByPredicate([](const AGravityBall* ball) { return ball && ball->IsGravityActive && ball->GravityAreaTrigger; });
+		if (!activeBall)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Shoot a gravity ball and stop it before running the field benchmark"));
+			return;
+		}
+
+		// same layout every run so the two backends see the same scene
+		FRandomStream random(1234);
+		const FVector center = (*activeBall)->GetActorLocation();
+		const float radius = (*activeBall)->GravityAreaTrigger->GetScaledSphereRadius();
+
+		FActorSpawnParameters spawnParams;
+		spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		for (int32 i = 0; i < count; i++)
+		{
+			const FVector location = center + random.GetUnitVector() * random.FRandRange(0.2f, 0.9f) * radius;
+			AStaticMeshActor* body = World->SpawnActor<AStaticMeshActor>(location, FRotator::ZeroRotator, spawnParams);
+			UStaticMeshComponent* mesh = body->GetStaticMeshComponent();
+			body->SetMobility(EComponentMobility::Movable);
+			body->Tags.Add(GravityBenchmarkTag);
+			mesh->SetStaticMesh(cube);
+			mesh->SetWorldScale3D(FVector(0.2f));
+			mesh->SetCollisionProfileName(UCollisionProfile::PhysicsActor_ProfileName);
+			mesh->SetGenerateOverlapEvents(true);
+			mesh->SetSimulatePhysics(true);
+		}
+		UE_LOG(LogTemp, Display, TEXT("Spawned %d benchmark bodies, gravity backend: %s"), count, UGravityFieldSubsystem::UsesChaosFields() ? TEXT("Chaos fields") : TEXT("AddForce"));
+	}));
+
+void FGravityFieldTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->TickGravity(DeltaTime);
+	}
+}
+
+FString FGravityFieldTickFunction::DiagnosticMessage()
+{
+	return TEXT("FGravityFieldTickFunction");
+}
+
+void UGravityFieldSubsystem::Deinitialize()
+{
+	if (GravityTickFunction.IsTickFunctionRegistered())
+	{
+		GravityTickFunction.UnRegisterTickFunction();
+	}
+	GravityBalls.Reset();
+
+	Super::Deinitialize();
+}
+
+void UGravityFieldSubsystem::RegisterGravityBall(AGravityBall* Ball)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	// the tick function is registered with the first ball, the level is guaranteed to exist by then
+	if (!GravityTickFunction.IsTickFunctionRegistered())
+	{
+		GravityTickFunction.Owner = this;
+		GravityTickFunction.bCanEverTick = true;
+		GravityTickFunction.TickGroup = TG_PrePhysics;
+		GravityTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	GravityBalls.AddUnique(Ball);
+}
+
+void UGravityFieldSubsystem::UnregisterGravityBall(AGravityBall* Ball)
+{
+	GravityBalls.RemoveSingleSwap(Ball);
+}
+
+void UGravityFieldSubsystem::GatherActiveFields(TArray<FGravityFieldState>& OutFields) const
+{
+	OutFields.Reset();
+	for (AGravityBall* ball : GravityBalls)
+	{
+		// same conditions AGravityBall::OnOverlapGravityBegin uses to turn a projectile into a homing one
+		if (ball && ball->IsGravityActive && ball->GravityAreaTrigger)
+		{
+			FGravityFieldState& field = OutFields.AddDefaulted_GetRef();
+			field.Location = ball->GravityBallMesh_Component ? ball->GravityBallMesh_Component->GetComponentLocation() : ball->GetActorLocation();
+			field.Radius = ball->GravityAreaTrigger->GetScaledSphereRadius();
+			field.HomingAcceleration = ball->ProjectileHomingAcceleration;
+			field.bInverted = ball->GravityMode != E_GravityMode::MODE_ATTRACTION;
+		}
+	}
+}
+
+void UGravityFieldSubsystem::TickGravity(float DeltaTime)
+{
+	FPS_ALLOC_SCOPE(GravityTick);
+
+	const double startTime = FPlatformTime::Seconds();
+	const double budgetSeconds = CVarGravityFrameBudgetMs.GetValueOnGameThread() * 0.001;
+	const int32 batchSize = budgetSeconds > 0.0 ? FMath::Max(1, CVarGravityBatchSize.GetValueOnGameThread()) : MAX_int32;
+
+	OcclusionTracesLeft = CVarGravityOcclusionTraceBudget.GetValueOnGameThread();
+
+	for (AGravityBall* ball : GravityBalls)
+	{
+		ball->BeginGravityUpdate();
+	}
+
+	// visit the balls starting with the one that was starved last frame, a batch of bodies at a time
+	const int32 numBalls = GravityBalls.Num();
+	int32 ballOffset = 0;
+	bool bOverBudget = false;
+	for (; ballOffset < numBalls && !bOverBudget; ballOffset++)
+	{
+		AGravityBall* ball = GravityBalls[(NextBall + ballOffset) % numBalls];
+		while (ball->GetBodiesLeftThisFrame() > 0)
+		{
+			if (budgetSeconds > 0.0 && FPlatformTime::Seconds() - startTime >= budgetSeconds)
+			{
+				bOverBudget = true;
+				break;
+			}
+			ball->ApplyGravityEffect(DeltaTime, batchSize);
+		}
+	}
+
+	Backlog = 0;
+	if (bOverBudget)
+	{
+		// the ball that ran out of budget goes first next frame
+		ballOffset--;
+		NextBall = numBalls > 0 ? (NextBall + ballOffset) % numBalls : 0;
+		for (AGravityBall* ball : GravityBalls)
+		{
+			Backlog += ball->GetBodiesLeftThisFrame();
+		}
+	}
+
+	const double elapsedSeconds = FPlatformTime::Seconds() - startTime;
+	NumFrames++;
+	NumOverBudgetFrames += bOverBudget ? 1 : 0;
+	MaxBacklog = FMath::Max(MaxBacklog, Backlog);
+	TotalSeconds += elapsedSeconds;
+	MaxSeconds = FMath::Max(MaxSeconds, elapsedSeconds);
+}
+
+int32 UGravityFieldSubsystem::ClaimOcclusionTraces(int32 Wanted)
+{
+	const int32 granted = FMath::Clamp(OcclusionTracesLeft, 0, Wanted);
+	OcclusionTracesLeft -= granted;
+	NumOcclusionTraces += granted;
+	NumOcclusionTracesDeferred += Wanted - granted;
+	return granted;
+}
+
+void UGravityFieldSubsystem::ReportSchedulerStats()
+{
+	UE_LOG(LogTemp, Display, TEXT("Gravity scheduler (%s): %d frames, %.3f ms avg, %.3f ms max, budget %.2f ms, %d frames over budget, backlog %d now / %d max, %d occlusion traces (%d deferred), %d Chaos field updates"),
+		UsesChaosFields() ? TEXT("Chaos fields") : TEXT("AddForce"), NumFrames, NumFrames > 0 ? TotalSeconds * 1000.0 / NumFrames : 0.0, MaxSeconds * 1000.0, CVarGravityFrameBudgetMs.GetValueOnGameThread(),
+		NumOverBudgetFrames, Backlog, MaxBacklog, NumOcclusionTraces, NumOcclusionTracesDeferred, NumChaosFieldUpdates);
+
+	NumFrames = 0;
+	NumOverBudgetFrames = 0;
+	MaxBacklog = 0;
+	TotalSeconds = 0.0;
+	MaxSeconds = 0.0;
+	NumOcclusionTraces = 0;
+	NumOcclusionTracesDeferred = 0;
+	NumChaosFieldUpdates = 0;
+}
+
+bool UGravityFieldSubsystem::UsesChaosFields()
+{
+#if WITH_FPS_CHAOS_FIELDS
+	return CVarGravityChaosFields.GetValueOnGameThread() != 0;
+#else
+	return false;
+#endif
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GravityFieldSubsystem.generated.h"
+
+class AGravityBall;
+class UGravityFieldSubsystem;
+
+/** Snapshot of a gravity field as seen by projectiles */
+struct FGravityFieldState
+{
+	FVector Location;
+	float Radius;
+	float HomingAcceleration;
+	bool bInverted;
+};
+
+/** Tick function that runs the gravity of every ball before physics */
+struct FGravityFieldTickFunction : public FTickFunction
+{
+	UGravityFieldSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Keeps track of every gravity ball in the world so systems can reason about all the active fields at once.
+ * It also schedules the gravity forces of all the balls within the fps.Gravity.FrameBudgetMs budget: when there are more
+ * bodies than fit in it they are visited round-robin over several frames, and each one gets the force it missed.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGravityFieldSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Called by the gravity balls when they begin/end play */
+	void RegisterGravityBall(AGravityBall* Ball);
+	void UnregisterGravityBall(AGravityBall* Ball);
+
+	/** Every registered gravity ball */
+	const TArray<AGravityBall*>& GetGravityBalls() const { return GravityBalls; }
+
+	/** Fills OutFields with the fields that currently bend projectiles */
+	void GatherActiveFields(TArray<FGravityFieldState>& OutFields) const;
+
+	/** Applies the gravity of every ball, as much as fits in the frame budget */
+	void TickGravity(float DeltaTime);
+
+	/** Takes up to Wanted occlusion traces from this frame's budget and returns how many were granted */
+	int32 ClaimOcclusionTraces(int32 Wanted);
+
+	/** Bodies left without an update the last frame because the budget ran out */
+	int32 GetBacklog() const { return Backlog; }
+
+	/** Logs the scheduler counters since the last report and resets them */
+	void ReportSchedulerStats();
+
+	/** True if the balls push the bodies with a Chaos field instead of AddForce. Needs a WITH_FPS_CHAOS_FIELDS build and fps.Gravity.ChaosFields */
+	static bool UsesChaosFields();
+
+	/** Counts a ball rebuilding its Chaos field */
+	void CountChaosFieldUpdate() { NumChaosFieldUpdates++; }
+
+private:
+	UPROPERTY(Transient)
+		TArray<AGravityBall*> GravityBalls;
+
+	FGravityFieldTickFunction GravityTickFunction;
+
+	/** Ball the next frame starts with, the one that ran out of budget last */
+	int32 NextBall = 0;
+
+	int32 Backlog = 0;
+
+	/** Occlusion traces left in this frame's budget */
+	int32 OcclusionTracesLeft = 0;
+
+	/** Counters since the last report */
+	int32 NumFrames = 0;
+	int32 NumOverBudgetFrames = 0;
+	int32 MaxBacklog = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+	int32 NumOcclusionTraces = 0;
+	int32 NumOcclusionTracesDeferred = 0;
+	int32 NumChaosFieldUpdates = 0;
+};
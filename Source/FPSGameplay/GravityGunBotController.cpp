@@ -0,0 +1,233 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunBotController.h"
+#include "FPSGameplayCharacter.h"
+#include "GravityGunMovementComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameModeBase.h"
+#include "HAL/IConsoleManager.h"
+
+AGravityGunBotController::AGravityGunBotController()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	Profile = E_BotProfile::PROFILE_MIXED;
+	ActionInterval = 0.25f;
+	TurnRate = 30.f;
+	ActionTimer = 0.f;
+	ActionStep = 0;
+	PlayTime = 0.f;
+	bIsHoldingHook = false;
+	bIsHoldingJump = false;
+	bReachedSwing = false;
+}
+
+void AGravityGunBotController::SetSeed(int32 Seed)
+{
+	RandomStream.Initialize(Seed);
+}
+
+void AGravityGunBotController::OnPossess(APawn* InPawn)
+{
+	Super::OnPossess(InPawn);
+
+	// bots don't get a player input component, build one with the same bindings a player would get
+	if (AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(InPawn))
+	{
+		character->InitializeBotInput();
+	}
+}
+
+void AGravityGunBotController::PressAction(FName ActionName)
+{
+	if (AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(GetPawn()))
+	{
+		character->InjectInputAction(ActionName, IE_Pressed);
+		character->InjectInputAction(ActionName, IE_Released);
+	}
+}
+
+void AGravityGunBotController::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(GetPawn());
+	if (!character)
+	{
+		return;
+	}
+
+	// keep moving and turning so the bots spread over the map, the pattern only depends on the play time
+	PlayTime += DeltaTime;
+	character->InjectInputAxis(TEXT("MoveForward"), FMath::Sin(PlayTime * 0.5f));
+	character->InjectInputAxis(TEXT("MoveRight"), FMath::Cos(PlayTime * 0.8f));
+
+	// aiming goes straight to the control rotation, the mouse bindings only work for player controllers
+	FRotator aim = GetControlRotation();
+	aim.Yaw += TurnRate * DeltaTime;
+	aim.Pitch = 10.f * FMath::Sin(PlayTime);
+	SetControlRotation(aim);
+
+	// swinging only starts while falling, the hook goes in once the held jump got the pawn off the ground
+	UGravityGunMovementComponent* movement = character->GetGravityGunMovement();
+	if (bIsHoldingJump && !bIsHoldingHook && movement->IsFalling())
+	{
+		character->InjectInputAction(TEXT("Hook"), IE_Pressed);
+		bIsHoldingHook = true;
+	}
+	bReachedSwing |= bIsHoldingHook && movement->IsSwinging();
+
+	ActionTimer -= DeltaTime;
+	if (ActionTimer <= 0.f)
+	{
+		ActionTimer += ActionInterval;
+		RunAction(Profile == E_BotProfile::PROFILE_MIXED ? (E_BotProfile)RandomStream.RandRange(0, (int32)E_BotProfile::PROFILE_MIXED - 1) : Profile);
+	}
+}
+
+void AGravityGunBotController::RunAction(E_BotProfile ActionProfile)
+{
+	AFPSGameplayCharacter* character = Cast<AFPSGameplayCharacter>(GetPawn());
+
+	switch (ActionProfile)
+	{
+	case E_BotProfile::PROFILE_SPAM_FIRE:
+		PressAction(TEXT("Fire"));
+		break;
+
+	case E_BotProfile::PROFILE_CONSTANT_HOOK:
+		// shoot the ball, stop it, switch to hook mode, jump and hang from it, then call it back
+		switch (ActionStep++ % 6)
+		{
+		case 0: PressAction(TEXT("ShootGravityBall")); break;
+		case 1: PressAction(TEXT("ShootGravityBall")); break;
+		case 2: PressAction(TEXT("GravityMode3")); break;
+		case 3:
+			character->InjectInputAction(TEXT("Jump"), IE_Pressed);
+			bIsHoldingJump = true;
+			bReachedSwing = false;
+			break;
+		case 4: break;
+		case 5:
+			ReleaseHook(character);
+			PressAction(TEXT("ReturnGravityBall"));
+			break;
+		}
+		break;
+
+	case E_BotProfile::PROFILE_MODE_CYCLE:
+	{
+		// shoot the ball and stop it on the next step, cycle through the modes, then call it back.
+		// A second press in the same frame would stop the ball at the muzzle
+		static const FName ModeActions[] = { TEXT("GravityMode1"), TEXT("GravityMode2"), TEXT("GravityMode3") };
+		const int32 step = ActionStep++ % 6;
+		if (step < 2)
+		{
+			PressAction(TEXT("ShootGravityBall"));
+		}
+		else if (step < 5)
+		{
+			PressAction(ModeActions[step - 2]);
+		}
+		else
+		{
+			PressAction(TEXT("ReturnGravityBall"));
+		}
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	// never leave the hook held when the mixed profile moves on to something else
+	if ((bIsHoldingHook || bIsHoldingJump) && ActionProfile != E_BotProfile::PROFILE_CONSTANT_HOOK)
+	{
+		ReleaseHook(character);
+	}
+}
+
+void AGravityGunBotController::ReleaseHook(AFPSGameplayCharacter* Character)
+{
+	if (bIsHoldingHook)
+	{
+		Character->InjectInputAction(TEXT("Hook"), IE_Released);
+		// the mixed profile can let go before the swing starts, the constant hook one holds long enough
+		if (!bReachedSwing && Profile == E_BotProfile::PROFILE_CONSTANT_HOOK)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Bot %s held the hook without swinging"), *GetName());
+		}
+	}
+	if (bIsHoldingJump)
+	{
+		Character->InjectInputAction(TEXT("Jump"), IE_Released);
+	}
+	bIsHoldingHook = false;
+	bIsHoldingJump = false;
+}
+
+/** Spawns bots with the default pawn of the game mode at the player starts */
+static FAutoConsoleCommandWithWorldAndArgs SpawnBotsCommand(
+	TEXT("fps.Bots.Spawn"),
+	TEXT("fps.Bots.Spawn <count> <profile: 0 spam fire, 1 constant hook, 2 mode cycle, 3 mixed> [seed]"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateLambda([](const TArray<FString>& Args, UWorld* World)
+	{
+		AGameModeBase* gameMode = World->GetAuthGameMode();
+		if (!gameMode)
+		{
+			UE_LOG(LogTemp, Warning, TEXT("Bots can only be spawned on the server"));
+			return;
+		}
+
+		const int32 count = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 1;
+		const E_BotProfile profile = (E_BotProfile)FMath::Clamp(Args.Num() > 1 ? FCString::Atoi(*Args[1]) : (int32)E_BotProfile::PROFILE_MIXED, 0, (int32)E_BotProfile::PROFILE_MIXED);
+		const int32 seed = Args.Num() > 2 ? FCString::Atoi(*Args[2]) : 0;
+
+		FActorSpawnParameters spawnParams;
+		spawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButAlwaysSpawn;
+
+		int32 numSpawned = 0;
+		for (int32 i = 0; i < count; i++)
+		{
+			AActor* start = gameMode->FindPlayerStart(nullptr);
+			const FTransform spawnTransform = start ? start->GetActorTransform() : FTransform::Identity;
+
+			APawn* pawn = World->SpawnActor<APawn>(gameMode->DefaultPawnClass, spawnTransform, spawnParams);
+			if (!pawn)
+			{
+				UE_LOG(LogTemp, Warning, TEXT("Couldn't spawn the default pawn of the game mode for a bot"));
+				break;
+			}
+
+			AGravityGunBotController* bot = World->SpawnActor<AGravityGunBotController>(spawnParams);
+			if (!bot)
+			{
+				pawn->Destroy();
+				break;
+			}
+
+			bot->Profile = profile;
+			bot->SetSeed(seed + i);
+			bot->Possess(pawn);
+			numSpawned++;
+		}
+
+		UE_LOG(LogTemp, Display, TEXT("Spawned %d bots with profile %d and seed %d"), numSpawned, (int32)profile, seed);
+	}));
+
+static FAutoConsoleCommandWithWorld ClearBotsCommand(
+	TEXT("fps.Bots.Clear"),
+	TEXT("Destroys every load test bot and its pawn"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		for (TActorIterator<AGravityGunBotController> it(World); it; ++it)
+		{
+			if (APawn* pawn = it->GetPawn())
+			{
+				pawn->Destroy();
+			}
+			it->Destroy();
+		}
+	}));
@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "AIController.h"
+#include "GravityGunBotController.generated.h"
+
+/** Enum for the behaviours the load test bots can run */
+UENUM(BlueprintType)
+enum class E_BotProfile : uint8
+{
+	PROFILE_SPAM_FIRE = 0	UMETA(DisplayName = "Spam Fire"),
+	PROFILE_CONSTANT_HOOK	UMETA(DisplayName = "Constant Hook"),
+	PROFILE_MODE_CYCLE	UMETA(DisplayName = "Mode Cycle"),
+	PROFILE_MIXED	UMETA(DisplayName = "Mixed")
+};
+
+/**
+ * Controller that drives an AFPSGameplayCharacter through the same input bindings a player uses,
+ * following a scripted behaviour profile. The random decisions come from a seeded stream so runs are repeatable.
+ * Spawn them with fps.Bots.Spawn <count> <profile> [seed].
+ */
+UCLASS()
+class FPSGAMEPLAY_API AGravityGunBotController : public AAIController
+{
+	GENERATED_BODY()
+
+public:
+	AGravityGunBotController();
+
+	/** Behaviour this bot runs */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Bot)
+		E_BotProfile Profile;
+
+	/** Seconds between two actions of the profile */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Bot)
+		float ActionInterval;
+
+	/** Degrees per second the bot turns while it plays */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Bot)
+		float TurnRate;
+
+	/** Seeds the random decisions of the bot */
+	void SetSeed(int32 Seed);
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+protected:
+	virtual void OnPossess(APawn* InPawn) override;
+
+	/** Runs the next action of the profile */
+	void RunAction(E_BotProfile ActionProfile);
+
+	/** Presses and releases an action binding of the pawn */
+	void PressAction(FName ActionName);
+
+	FRandomStream RandomStream;
+
+	/** Time left until the next action */
+	float ActionTimer;
+
+	/** Step of the scripted sequence the profile is in */
+	int32 ActionStep;
+
+	/** Time the bot has been playing, drives the movement pattern */
+	float PlayTime;
+
+	/** True while the bot holds the hook action */
+	bool bIsHoldingHook;
+
+	/** True while the bot holds the jump action, the hook is pressed once the jump has it falling */
+	bool bIsHoldingJump;
+
+	/** True once the held hook got the pawn swinging */
+	bool bReachedSwing;
+
+	/** Releases the hook and jump actions, warns if the constant hook profile held the hook without the pawn ever swinging */
+	void ReleaseHook(class AFPSGameplayCharacter* Character);
+};
@@ -0,0 +1,440 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunMovementComponent.h"
+#include "GameFramework/Character.h"
+#include "Components/CapsuleComponent.h"
+#include "Serialization/BitWriter.h"
+#include "HAL/IConsoleManager.h"
+
+/** Network counters of the gravity gun movement, for the whole process */
+struct FGravityGunMovementNetStats
+{
+	int32 CorrectionsSent = 0;
+	int32 CorrectionsReceived = 0;
+	int32 PackedMovesSent = 0;
+	int64 PackedMoveBits = 0;
+	int64 SwingPayloadBits = 0;
+	int64 PullPayloadBits = 0;
+};
+
+static FGravityGunMovementNetStats NetStats;
+
+static FAutoConsoleCommand MovementNetStatsCommand(
+	TEXT("fps.Movement.NetStats"),
+	TEXT("Prints the movement corrections and the size of the packed moves since the last call, then resets them"),
+	FConsoleCommandDelegate::CreateLambda([]()
+	{
+		UE_LOG(LogTemp, Display, TEXT("Movement: %d corrections sent, %d corrections received, %d packed moves sent (%.1f bytes avg, %lld bytes of swing data, %lld bytes of gravity pull data)"),
+			NetStats.CorrectionsSent, NetStats.CorrectionsReceived, NetStats.PackedMovesSent,
+			NetStats.PackedMovesSent > 0 ? (float)NetStats.PackedMoveBits / (8.f * NetStats.PackedMovesSent) : 0.f, NetStats.SwingPayloadBits / 8, NetStats.PullPayloadBits / 8);
+		NetStats = FGravityGunMovementNetStats();
+	}));
+
+//////////////////////////////////////////////////////////////////////////
+// FSavedMove_GravityGun
+
+void FSavedMove_GravityGun::Clear()
+{
+	Super::Clear();
+
+	bSavedWantsToSwing = false;
+	SavedSwingAnchor = FVector::ZeroVector;
+	SavedSwingLength = 0.f;
+	SavedGravityPull = FVector::ZeroVector;
+}
+
+uint8 FSavedMove_GravityGun::GetCompressedFlags() const
+{
+	uint8 result = Super::GetCompressedFlags();
+	if (bSavedWantsToSwing)
+	{
+		result |= FLAG_Custom_0;
+	}
+	if (!SavedGravityPull.IsZero())
+	{
+		result |= FLAG_Custom_1;
+	}
+	return result;
+}
+
+bool FSavedMove_GravityGun::CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const
+{
+	const FSavedMove_GravityGun* newMove = static_cast<const FSavedMove_GravityGun*>(NewMove.Get());
+	if (bSavedWantsToSwing != newMove->bSavedWantsToSwing || SavedSwingAnchor != newMove->SavedSwingAnchor || SavedSwingLength != newMove->SavedSwingLength || SavedGravityPull != newMove->SavedGravityPull)
+	{
+		return false;
+	}
+	return Super::CanCombineWith(NewMove, InCharacter, MaxDelta);
+}
+
+void FSavedMove_GravityGun::SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, FNetworkPredictionData_Client_Character& ClientData)
+{
+	Super::SetMoveFor(C, InDeltaTime, NewAccel, ClientData);
+
+	if (const UGravityGunMovementComponent* movement = Cast<UGravityGunMovementComponent>(C->GetCharacterMovement()))
+	{
+		bSavedWantsToSwing = movement->bWantsToSwing;
+		SavedSwingAnchor = movement->SwingAnchor;
+		SavedSwingLength = movement->SwingLength;
+
+		// the pull this move is about to consume, as the acceleration the server will get
+		SavedGravityPull = movement->Mass > SMALL_NUMBER ? UGravityGunMovementComponent::QuantizeNet10(movement->PendingGravityPull / movement->Mass) : FVector::ZeroVector;
+	}
+}
+
+void FSavedMove_GravityGun::PrepMoveFor(ACharacter* C)
+{
+	Super::PrepMoveFor(C);
+
+	if (UGravityGunMovementComponent* movement = Cast<UGravityGunMovementComponent>(C->GetCharacterMovement()))
+	{
+		movement->bWantsToSwing = bSavedWantsToSwing;
+		movement->SwingAnchor = SavedSwingAnchor;
+		movement->SwingLength = SavedSwingLength;
+		movement->PendingGravityPull = SavedGravityPull * movement->Mass;
+	}
+}
+
+FSavedMovePtr FNetworkPredictionData_Client_GravityGun::AllocateNewMove()
+{
+	return FSavedMovePtr(new FSavedMove_GravityGun());
+}
+
+//////////////////////////////////////////////////////////////////////////
+// FGravityGunNetworkMoveData
+
+void FGravityGunNetworkMoveData::ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType)
+{
+	Super::ClientFillNetworkMoveData(ClientMove, MoveType);
+
+	const FSavedMove_GravityGun& move = static_cast<const FSavedMove_GravityGun&>(ClientMove);
+	SwingAnchor = move.SavedSwingAnchor;
+	SwingLength = (uint16)FMath::Clamp(FMath::RoundToInt(move.SavedSwingLength), 0, (int32)MAX_uint16);
+	GravityPull = move.SavedGravityPull;
+}
+
+bool FGravityGunNetworkMoveData::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType)
+{
+	Super::Serialize(CharacterMovement, Ar, PackageMap, MoveType);
+
+	// the flags are already serialized, the hook state only travels while the character is hooked
+	if (CompressedMoveFlags & FSavedMove_Character::FLAG_Custom_0)
+	{
+		const int64 startBits = Ar.IsSaving() ? static_cast<FBitWriter&>(Ar).GetNumBits() : 0;
+
+		bool bSuccess = true;
+		SwingAnchor.NetSerialize(Ar, PackageMap, bSuccess);
+		Ar << SwingLength;
+
+		if (Ar.IsSaving())
+		{
+			NetStats.SwingPayloadBits += static_cast<FBitWriter&>(Ar).GetNumBits() - startBits;
+		}
+	}
+
+	if (CompressedMoveFlags & FSavedMove_Character::FLAG_Custom_1)
+	{
+		const int64 startBits = Ar.IsSaving() ? static_cast<FBitWriter&>(Ar).GetNumBits() : 0;
+
+		bool bSuccess = true;
+		GravityPull.NetSerialize(Ar, PackageMap, bSuccess);
+
+		if (Ar.IsSaving())
+		{
+			NetStats.PullPayloadBits += static_cast<FBitWriter&>(Ar).GetNumBits() - startBits;
+		}
+	}
+	else if (Ar.IsLoading())
+	{
+		GravityPull = FVector::ZeroVector;
+	}
+
+	return !Ar.IsError();
+}
+
+FGravityGunNetworkMoveDataContainer::FGravityGunNetworkMoveDataContainer()
+{
+	NewMoveData = &MoveData[0];
+	PendingMoveData = &MoveData[1];
+	OldMoveData = &MoveData[2];
+}
+
+bool FGravityGunNetworkMoveDataContainer::Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap)
+{
+	// the client packs the moves with an FNetBitWriter, so the bit count can be read straight from it
+	const int64 startBits = Ar.IsSaving() ? static_cast<FBitWriter&>(Ar).GetNumBits() : 0;
+
+	const bool bSuccess = Super::Serialize(CharacterMovement, Ar, PackageMap);
+
+	if (Ar.IsSaving())
+	{
+		NetStats.PackedMovesSent++;
+		NetStats.PackedMoveBits += static_cast<FBitWriter&>(Ar).GetNumBits() - startBits;
+	}
+
+	return bSuccess;
+}
+
+//////////////////////////////////////////////////////////////////////////
+// UGravityGunMovementComponent
+
+UGravityGunMovementComponent::UGravityGunMovementComponent()
+{
+	SwingControl = 0.2f;
+	MaxSwingSpeed = 3000.f;
+	MinSwingLength = 100.f;
+
+	GravityPullThreshold = 1500.f;
+	GravityPullExitRatio = 0.5f;
+	MaxGravityPullSpeed = 2500.f;
+
+	bWantsToSwing = false;
+	SwingAnchor = FVector::ZeroVector;
+	SwingLength = 0.f;
+	PendingGravityPull = FVector::ZeroVector;
+	GravityPullAcceleration = FVector::ZeroVector;
+
+	SetNetworkMoveDataContainer(GravityGunMoveDataContainer);
+}
+
+FNetworkPredictionData_Client* UGravityGunMovementComponent::GetPredictionData_Client() const
+{
+	if (!ClientPredictionData)
+	{
+		UGravityGunMovementComponent* mutableThis = const_cast<UGravityGunMovementComponent*>(this);
+		mutableThis->ClientPredictionData = new FNetworkPredictionData_Client_GravityGun(*this);
+	}
+	return ClientPredictionData;
+}
+
+FVector UGravityGunMovementComponent::QuantizeNet10(const FVector& Value)
+{
+	return FVector(FMath::RoundToFloat(Value.X * 10.f), FMath::RoundToFloat(Value.Y * 10.f), FMath::RoundToFloat(Value.Z * 10.f)) / 10.f;
+}
+
+void UGravityGunMovementComponent::StartSwinging(const FVector& Anchor)
+{
+	bWantsToSwing = true;
+	// the server gets the anchor as a FVector_NetQuantize10 and the length as a uint16, the client swings with the same values
+	SwingAnchor = QuantizeNet10(Anchor);
+	SwingLength = (float)FMath::Clamp(FMath::RoundToInt(FMath::Max(MinSwingLength, FVector::Dist(UpdatedComponent->GetComponentLocation(), Anchor))), 0, (int32)MAX_uint16);
+}
+
+void UGravityGunMovementComponent::StopSwinging()
+{
+	bWantsToSwing = false;
+}
+
+void UGravityGunMovementComponent::AddGravityPull(const FVector& Force)
+{
+	PendingGravityPull += Force;
+}
+
+void UGravityGunMovementComponent::UpdateFromCompressedFlags(uint8 Flags)
+{
+	Super::UpdateFromCompressedFlags(Flags);
+
+	bWantsToSwing = (Flags & FSavedMove_Character::FLAG_Custom_0) != 0;
+}
+
+void UGravityGunMovementComponent::MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel)
+{
+	// the server takes the hook state of the move before simulating it
+	if (const FGravityGunNetworkMoveData* moveData = static_cast<const FGravityGunNetworkMoveData*>(GetCurrentNetworkMoveData()))
+	{
+		if (CompressedFlags & FSavedMove_Character::FLAG_Custom_0)
+		{
+			SwingAnchor = moveData->SwingAnchor;
+			SwingLength = moveData->SwingLength;
+		}
+
+		// the client's pull replaces the one the server's fields added, both sides simulate the move with the same one
+		PendingGravityPull = moveData->GravityPull * Mass;
+	}
+
+	Super::MoveAutonomous(ClientTimeStamp, DeltaTime, CompressedFlags, NewAccel);
+}
+
+void UGravityGunMovementComponent::UpdateCharacterStateBeforeMovement(float DeltaSeconds)
+{
+	Super::UpdateCharacterStateBeforeMovement(DeltaSeconds);
+
+	// the hook only takes over while in the air, landing ends the swing until the next jump
+	if (bWantsToSwing && IsFalling())
+	{
+		SetMovementMode(MOVE_Custom, (uint8)E_GravityGunMovementMode::CMOVE_Swinging);
+	}
+	else if (!bWantsToSwing && IsSwinging())
+	{
+		SetMovementMode(MOVE_Falling);
+	}
+
+	// a strong field takes the character over, leaving only when the pull drops well under the threshold.
+	// Weak pulls go through the regular accumulated forces of walking and falling.
+	// The pull is quantized like the network moves, the server simulates with the one the client sent
+	const FVector pullAcceleration = Mass > SMALL_NUMBER ? QuantizeNet10(PendingGravityPull / Mass) : FVector::ZeroVector;
+	const FVector pullForce = pullAcceleration * Mass;
+	PendingGravityPull = FVector::ZeroVector;
+
+	const float pullSquared = pullAcceleration.SizeSquared();
+	if (IsGravityPulled())
+	{
+		if (pullSquared < FMath::Square(GravityPullThreshold * GravityPullExitRatio))
+		{
+			SetMovementMode(MOVE_Falling);
+			AddForce(pullForce);
+		}
+	}
+	else if (!IsSwinging() && pullSquared > FMath::Square(GravityPullThreshold) && (!IsMovingOnGround() || pullAcceleration.Z + GetGravityZ() > 0.f))
+	{
+		// on the ground only a pull that lifts the character takes over. Any other pull would land it again on the
+		// next update, it stays walking and gets the pull as a force along the floor
+		SetMovementMode(MOVE_Custom, (uint8)E_GravityGunMovementMode::CMOVE_GravityPulled);
+	}
+	else if (pullSquared > 0.f)
+	{
+		AddForce(pullForce);
+	}
+	GravityPullAcceleration = IsGravityPulled() ? pullAcceleration : FVector::ZeroVector;
+}
+
+bool UGravityGunMovementComponent::ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode)
+{
+	const bool bError = Super::ServerCheckClientError(ClientTimeStamp, DeltaTime, Accel, ClientWorldLocation, RelativeClientLocation, ClientMovementBase, ClientBaseBoneName, ClientMovementMode);
+	NetStats.CorrectionsSent += bError ? 1 : 0;
+	return bError;
+}
+
+void UGravityGunMovementComponent::OnClientCorrectionReceived(FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode)
+{
+	NetStats.CorrectionsReceived++;
+
+	Super::OnClientCorrectionReceived(ClientData, TimeStamp, NewLocation, NewVelocity, NewBase, NewBaseBoneName, bHasBase, bBaseRelativePosition, ServerMovementMode);
+}
+
+float UGravityGunMovementComponent::GetMaxSpeed() const
+{
+	if (IsSwinging())
+	{
+		return MaxSwingSpeed;
+	}
+	return IsGravityPulled() ? MaxGravityPullSpeed : Super::GetMaxSpeed();
+}
+
+void UGravityGunMovementComponent::PhysCustom(float deltaTime, int32 Iterations)
+{
+	switch ((E_GravityGunMovementMode)CustomMovementMode)
+	{
+	case E_GravityGunMovementMode::CMOVE_Swinging:
+		PhysSwinging(deltaTime, Iterations);
+		break;
+	case E_GravityGunMovementMode::CMOVE_GravityPulled:
+		PhysGravityPulled(deltaTime, Iterations);
+		break;
+	default:
+		break;
+	}
+
+	Super::PhysCustom(deltaTime, Iterations);
+}
+
+void UGravityGunMovementComponent::PhysSwinging(float deltaTime, int32 Iterations)
+{
+	if (deltaTime < MIN_TICK_TIME)
+	{
+		return;
+	}
+
+	if (!bWantsToSwing)
+	{
+		SetMovementMode(MOVE_Falling);
+		StartNewPhysics(deltaTime, Iterations);
+		return;
+	}
+
+	Iterations++;
+	bJustTeleported = false;
+
+	// gravity and a bit of steering from the input
+	const FVector inputAcceleration = Acceleration.GetClampedToMaxSize(GetMaxAcceleration()) * SwingControl;
+	Velocity += (FVector(0.f, 0.f, GetGravityZ()) + inputAcceleration) * deltaTime;
+
+	// the rope only pulls: once it's taut, remove the velocity taking the character away from the anchor
+	const FVector oldLocation = UpdatedComponent->GetComponentLocation();
+	const FVector rope = oldLocation - SwingAnchor;
+	const float ropeLength = rope.Size();
+	if (ropeLength >= SwingLength && ropeLength > KINDA_SMALL_NUMBER)
+	{
+		const FVector ropeDirection = rope / ropeLength;
+		const float outwardSpeed = FVector::DotProduct(Velocity, ropeDirection);
+		if (outwardSpeed > 0.f)
+		{
+			Velocity -= ropeDirection * outwardSpeed;
+		}
+	}
+	Velocity = Velocity.GetClampedToMaxSize(MaxSwingSpeed);
+
+	const FVector delta = Velocity * deltaTime;
+	FHitResult hit(1.f);
+	SafeMoveUpdatedComponent(delta, UpdatedComponent->GetComponentQuat(), true, hit);
+
+	if (hit.Time < 1.f)
+	{
+		// landing ends the swing, anything else is slid along
+		if (IsValidLandingSpot(UpdatedComponent->GetComponentLocation(), hit))
+		{
+			ProcessLanded(hit, deltaTime * (1.f - hit.Time), Iterations);
+			return;
+		}
+
+		HandleImpact(hit, deltaTime, delta);
+		SlideAlongSurface(delta, 1.f - hit.Time, hit.Normal, hit, true);
+	}
+
+	// pull the character back on the rope, the integration lets it drift outwards a little every step
+	const FVector newRope = UpdatedComponent->GetComponentLocation() - SwingAnchor;
+	if (newRope.SizeSquared() > FMath::Square(SwingLength))
+	{
+		const FVector correction = SwingAnchor + newRope.GetSafeNormal() * SwingLength - UpdatedComponent->GetComponentLocation();
+		SafeMoveUpdatedComponent(correction, UpdatedComponent->GetComponentQuat(), true, hit);
+	}
+
+	if (!bJustTeleported && !HasAnimRootMotion())
+	{
+		Velocity = (UpdatedComponent->GetComponentLocation() - oldLocation) / deltaTime;
+	}
+}
+
+void UGravityGunMovementComponent::PhysGravityPulled(float deltaTime, int32 Iterations)
+{
+	if (deltaTime < MIN_TICK_TIME)
+	{
+		return;
+	}
+
+	Iterations++;
+	bJustTeleported = false;
+
+	// the field does all the work, no input, no floor and no step ups
+	Velocity += (FVector(0.f, 0.f, GetGravityZ()) + GravityPullAcceleration) * deltaTime;
+	Velocity = Velocity.GetClampedToMaxSize(MaxGravityPullSpeed);
+
+	const FVector delta = Velocity * deltaTime;
+	FHitResult hit(1.f);
+	SafeMoveUpdatedComponent(delta, UpdatedComponent->GetComponentQuat(), true, hit);
+
+	if (hit.Time < 1.f)
+	{
+		// pushed onto a floor by a pull that doesn't lift the character: back to walking
+		if (GravityPullAcceleration.Z + GetGravityZ() <= 0.f && IsValidLandingSpot(UpdatedComponent->GetComponentLocation(), hit))
+		{
+			ProcessLanded(hit, deltaTime * (1.f - hit.Time), Iterations);
+			return;
+		}
+
+		// anything else just stops the motion into it, the next update carries on along the surface
+		HandleImpact(hit, deltaTime, delta);
+		Velocity = FVector::VectorPlaneProject(Velocity, hit.Normal);
+	}
+}
@@ -0,0 +1,162 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GravityGunMovementComponent.generated.h"
+
+/** Custom movement modes of the gravity gun characters */
+UENUM(BlueprintType)
+enum class E_GravityGunMovementMode : uint8
+{
+	CMOVE_None = 0	UMETA(Hidden),
+	CMOVE_Swinging	UMETA(DisplayName = "Swinging"),
+	CMOVE_GravityPulled	UMETA(DisplayName = "Gravity Pulled")
+};
+
+/** Saved move with the hook state, replayed after a correction */
+class FSavedMove_GravityGun : public FSavedMove_Character
+{
+public:
+	typedef FSavedMove_Character Super;
+
+	virtual void Clear() override;
+	virtual uint8 GetCompressedFlags() const override;
+	virtual bool CanCombineWith(const FSavedMovePtr& NewMove, ACharacter* InCharacter, float MaxDelta) const override;
+	virtual void SetMoveFor(ACharacter* C, float InDeltaTime, FVector const& NewAccel, class FNetworkPredictionData_Client_Character& ClientData) override;
+	virtual void PrepMoveFor(ACharacter* C) override;
+
+	uint8 bSavedWantsToSwing : 1;
+	FVector SavedSwingAnchor;
+	float SavedSwingLength;
+
+	/** Acceleration of the gravity fields the move was made with, replayed so corrections don't lose the pull */
+	FVector SavedGravityPull;
+};
+
+class FNetworkPredictionData_Client_GravityGun : public FNetworkPredictionData_Client_Character
+{
+public:
+	typedef FNetworkPredictionData_Client_Character Super;
+
+	FNetworkPredictionData_Client_GravityGun(const UCharacterMovementComponent& ClientMovement) : Super(ClientMovement) {}
+
+	virtual FSavedMovePtr AllocateNewMove() override;
+};
+
+/** Move sent to the server. The anchor and the rope length are only written while swinging, the gravity pull while there is one */
+struct FGravityGunNetworkMoveData : public FCharacterNetworkMoveData
+{
+	typedef FCharacterNetworkMoveData Super;
+
+	FVector_NetQuantize10 SwingAnchor;
+	uint16 SwingLength;
+	FVector_NetQuantize10 GravityPull;
+
+	virtual void ClientFillNetworkMoveData(const FSavedMove_Character& ClientMove, ENetworkMoveType MoveType) override;
+	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap, ENetworkMoveType MoveType) override;
+};
+
+struct FGravityGunNetworkMoveDataContainer : public FCharacterNetworkMoveDataContainer
+{
+	typedef FCharacterNetworkMoveDataContainer Super;
+
+	FGravityGunNetworkMoveDataContainer();
+
+	virtual bool Serialize(UCharacterMovementComponent& CharacterMovement, FArchive& Ar, UPackageMap* PackageMap) override;
+
+	FGravityGunNetworkMoveData MoveData[3];
+};
+
+/**
+ * Character movement with the gravity hook swing as a custom movement mode.
+ * The pendulum runs in PhysCustom, so the owning client predicts it and replays it after corrections like any other movement.
+ * Characters caught in a strong gravity field switch to a cheap custom mode that only follows the pull. The pull is part of
+ * the saved and network moves: the server and the replays use the one the client simulated with.
+ * fps.Movement.NetStats prints the corrections and the bytes of the packed moves.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGravityGunMovementComponent : public UCharacterMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UGravityGunMovementComponent();
+
+	/** Fraction of the max acceleration the input adds while swinging */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Swinging")
+		float SwingControl;
+
+	/** Max speed while swinging */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Swinging")
+		float MaxSwingSpeed;
+
+	/** Shortest rope, the hook never pulls the character closer than this to the anchor */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Swinging")
+		float MinSwingLength;
+
+	/** Pull acceleration of a gravity field above which the character stops walking/falling and just follows the pull */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Gravity Pull")
+		float GravityPullThreshold;
+
+	/** Fraction of GravityPullThreshold under which the character goes back to walking/falling, keeps it from flickering at the edge */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Gravity Pull", meta = (ClampMin = "0.0", ClampMax = "1.0"))
+		float GravityPullExitRatio;
+
+	/** Max speed while pulled by a gravity field */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Character Movement: Gravity Pull")
+		float MaxGravityPullSpeed;
+
+	/** Adds the force of a gravity field for the next update. Strong enough pulls switch to CMOVE_GravityPulled, weaker ones are applied like AddForce */
+	void AddGravityPull(const FVector& Force);
+
+	bool IsGravityPulled() const { return IsCustomMovementMode((uint8)E_GravityGunMovementMode::CMOVE_GravityPulled); }
+
+	/** Hooks the character to an anchor, the rope length is the current distance to it. It starts swinging the next time it's falling */
+	void StartSwinging(const FVector& Anchor);
+
+	/** Releases the hook */
+	void StopSwinging();
+
+	/** Moves the anchor of the hook, used when the hook is attached to something that moves */
+	void SetSwingAnchor(const FVector& Anchor) { SwingAnchor = QuantizeNet10(Anchor); }
+
+	bool WantsToSwing() const { return bWantsToSwing; }
+	bool IsSwinging() const { return IsCustomMovementMode((uint8)E_GravityGunMovementMode::CMOVE_Swinging); }
+
+	// UCharacterMovementComponent interface
+	virtual FNetworkPredictionData_Client* GetPredictionData_Client() const override;
+	virtual void UpdateFromCompressedFlags(uint8 Flags) override;
+	virtual void UpdateCharacterStateBeforeMovement(float DeltaSeconds) override;
+	virtual void MoveAutonomous(float ClientTimeStamp, float DeltaTime, uint8 CompressedFlags, const FVector& NewAccel) override;
+	virtual bool ServerCheckClientError(float ClientTimeStamp, float DeltaTime, const FVector& Accel, const FVector& ClientWorldLocation, const FVector& RelativeClientLocation, UPrimitiveComponent* ClientMovementBase, FName ClientBaseBoneName, uint8 ClientMovementMode) override;
+	virtual void OnClientCorrectionReceived(class FNetworkPredictionData_Client_Character& ClientData, float TimeStamp, FVector NewLocation, FVector NewVelocity, UPrimitiveComponent* NewBase, FName NewBaseBoneName, bool bHasBase, bool bBaseRelativePosition, uint8 ServerMovementMode) override;
+	virtual float GetMaxSpeed() const override;
+	// End of UCharacterMovementComponent interface
+
+protected:
+	virtual void PhysCustom(float deltaTime, int32 Iterations) override;
+
+	/** Pendulum: gravity and a bit of input, with the rope removing the velocity that would take the character away from the anchor */
+	void PhysSwinging(float deltaTime, int32 Iterations);
+
+	/** Follows the pull of the gravity fields with one capsule sweep per update, without floor checks or step ups */
+	void PhysGravityPulled(float deltaTime, int32 Iterations);
+
+	friend class FSavedMove_GravityGun;
+	friend struct FGravityGunNetworkMoveData;
+
+	uint8 bWantsToSwing : 1;
+	FVector SwingAnchor;
+	float SwingLength;
+
+	/** Rounds the way FVector_NetQuantize10 does, so the client simulates with the values the server gets */
+	static FVector QuantizeNet10(const FVector& Value);
+
+	/** Field forces added since the last update, and the acceleration they give in CMOVE_GravityPulled */
+	FVector PendingGravityPull;
+	FVector GravityPullAcceleration;
+
+	FGravityGunNetworkMoveDataContainer GravityGunMoveDataContainer;
+};
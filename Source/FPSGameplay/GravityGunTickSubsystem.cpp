@@ -0,0 +1,129 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunTickSubsystem.h"
+#include "FPSGameplayCharacter.h"
+#include "GravityBall.h"
+#include "Engine/World.h"
+#include "GravityGunMovementComponent.h"
+#include "FPSGameplayMemory.h"
+
+void FGravityGunBatchTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->TickCharacters(DeltaTime);
+	}
+}
+
+FString FGravityGunBatchTickFunction::DiagnosticMessage()
+{
+	return TEXT("FGravityGunBatchTickFunction");
+}
+
+void UGravityGunTickSubsystem::Deinitialize()
+{
+	if (BatchTickFunction.IsTickFunctionRegistered())
+	{
+		BatchTickFunction.UnRegisterTickFunction();
+	}
+	States.Reset();
+	StateIndices.Reset();
+
+	Super::Deinitialize();
+}
+
+void UGravityGunTickSubsystem::RegisterCharacter(AFPSGameplayCharacter* Character)
+{
+	FPS_LLM_SCOPE(CharacterGameplay);
+
+	if (!Character || StateIndices.Contains(Character))
+	{
+		return;
+	}
+
+	// the tick function is registered with the first character, the level is guaranteed to exist by then
+	if (!BatchTickFunction.IsTickFunctionRegistered())
+	{
+		BatchTickFunction.Owner = this;
+		BatchTickFunction.bCanEverTick = true;
+		BatchTickFunction.TickGroup = TG_PrePhysics;
+		BatchTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	FGravityGunCharacterState& state = States.AddDefaulted_GetRef();
+	state.Character = Character;
+	state.Ball = Character->GravityBall;
+	state.bSwinging = false;
+	state.bHookedToBall = false;
+	StateIndices.Add(Character, States.Num() - 1);
+}
+
+void UGravityGunTickSubsystem::UnregisterCharacter(AFPSGameplayCharacter* Character)
+{
+	int32 index;
+	if (!StateIndices.RemoveAndCopyValue(Character, index))
+	{
+		return;
+	}
+
+	if (UTimingWheelSubsystem* timingWheel = GetWorld()->GetSubsystem<UTimingWheelSubsystem>())
+	{
+		timingWheel->Cancel(States[index].BallTimeoutHandle);
+	}
+
+	// keep the array packed, the last state takes the removed slot
+	States.RemoveAtSwap(index, 1, false);
+	if (States.IsValidIndex(index))
+	{
+		StateIndices[States[index].Character] = index;
+	}
+}
+
+FGravityGunCharacterState* UGravityGunTickSubsystem::FindState(const AFPSGameplayCharacter* Character)
+{
+	const int32* index = StateIndices.Find(Character);
+	return index ? &States[*index] : nullptr;
+}
+
+void UGravityGunTickSubsystem::TickCharacters(float DeltaTime)
+{
+	FPS_ALLOC_SCOPE(CharacterTick);
+
+	for (int32 i = 0; i < States.Num(); i++)
+	{
+		FGravityGunCharacterState& state = States[i];
+		AFPSGameplayCharacter* character = state.Character;
+
+		//handle the swing. The owning client drives it, the server gets it through the saved moves
+		if (state.bSwinging && character->IsLocallyControlled())
+		{
+			UGravityGunMovementComponent* movement = character->GetGravityGunMovement();
+			const AGravityBall* ball = state.Ball.Get();
+			const bool bHookHolds = !state.bHookedToBall || (ball && ball->GravityMode == E_GravityMode::MODE_HOOK && ball->IsGravityActive);
+			if (bHookHolds)
+			{
+				if (!movement->WantsToSwing())
+				{
+					movement->StartSwinging(character->HookAnchorLocation);
+				}
+				character->HangFromGravityHook();
+			}
+			else if (movement->WantsToSwing())
+			{
+				movement->StopSwinging();
+			}
+		}
+
+		//only the local player needs to know what it's aiming at. Server side bots are locally controlled too
+		if (character->IsPlayerControlled() && character->IsLocallyControlled())
+		{
+			character->UpdateHookTarget();
+
+			if (character->ShowTrajectoryPreview)
+			{
+				character->UpdateTrajectoryPreview();
+			}
+		}
+	}
+}
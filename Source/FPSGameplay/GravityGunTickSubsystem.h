@@ -0,0 +1,66 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TimingWheelSubsystem.h"
+#include "GravityGunTickSubsystem.generated.h"
+
+class AFPSGameplayCharacter;
+class AGravityBall;
+class UGravityGunTickSubsystem;
+
+/** Gameplay side state of one gravity gun character, packed so the whole array is processed in one pass */
+struct FGravityGunCharacterState
+{
+	AFPSGameplayCharacter* Character;
+	/** The ball can be destroyed while the character is hooked to it */
+	TWeakObjectPtr<AGravityBall> Ball;
+	FTimingWheelHandle BallTimeoutHandle;
+	uint8 bSwinging : 1;
+	uint8 bHookedToBall : 1;
+};
+
+/** Single tick function that runs the gravity gun logic of every character */
+struct FGravityGunBatchTickFunction : public FTickFunction
+{
+	UGravityGunTickSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Runs the per frame gravity gun logic (hook swing, hook target and trajectory preview)
+ * for every character from one registered tick function, instead of one actor tick per character.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGravityGunTickSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/** Adds a character to the batch. Its gravity ball has to be spawned already */
+	void RegisterCharacter(AFPSGameplayCharacter* Character);
+
+	/** Removes a character from the batch */
+	void UnregisterCharacter(AFPSGameplayCharacter* Character);
+
+	/** State of a registered character, null if it isn't registered */
+	FGravityGunCharacterState* FindState(const AFPSGameplayCharacter* Character);
+
+	/** Processes every registered character */
+	void TickCharacters(float DeltaTime);
+
+private:
+	TArray<FGravityGunCharacterState> States;
+
+	/** Index of every registered character in States */
+	TMap<const AFPSGameplayCharacter*, int32> StateIndices;
+
+	FGravityGunBatchTickFunction BatchTickFunction;
+};
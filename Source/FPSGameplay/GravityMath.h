@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/**
+ * Engine independent math kernels for the gravity gun.
+ * This header only depends on the C++ standard library so the kernels can be compiled, tested and benchmarked
+ * outside of the editor. The gameplay classes convert their FVectors with the helpers in GravityMathConversions.h.
+ */
+
+#include <cmath>
+#include <cstdint>
+
+namespace GravityMath
+{
+	/** Minimal 3 component vector, layout compatible with FVector */
+	struct FVec3
+	{
+		float X;
+		float Y;
+		float Z;
+
+		FVec3() : X(0.f), Y(0.f), Z(0.f) {}
+		FVec3(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		inline FVec3 operator+(const FVec3& Other) const { return FVec3(X + Other.X, Y + Other.Y, Z + Other.Z); }
+		inline FVec3 operator-(const FVec3& Other) const { return FVec3(X - Other.X, Y - Other.Y, Z - Other.Z); }
+		inline FVec3 operator*(float Scale) const { return FVec3(X * Scale, Y * Scale, Z * Scale); }
+		inline FVec3 operator-() const { return FVec3(-X, -Y, -Z); }
+		inline FVec3& operator+=(const FVec3& Other) { X += Other.X; Y += Other.Y; Z += Other.Z; return *this; }
+	};
+
+	/** Squared lengths below this are treated as zero when normalizing */
+	static const float SmallNumber = 1.e-8f;
+
+	inline float Dot(const FVec3& A, const FVec3& B)
+	{
+		return A.X * B.X + A.Y * B.Y + A.Z * B.Z;
+	}
+
+	inline float SizeSquared(const FVec3& V)
+	{
+		return Dot(V, V);
+	}
+
+	/** Same contract as FVector::GetSafeNormal: returns a zero vector when the input is too small to normalize */
+	inline FVec3 SafeNormal(const FVec3& V)
+	{
+		const float SquareSum = SizeSquared(V);
+		if (SquareSum < SmallNumber)
+		{
+			return FVec3();
+		}
+		return V * (1.f / std::sqrt(SquareSum));
+	}
+
+	/** Force that pulls a body towards the ball. Grows linearly with the distance to the center */
+	inline FVec3 AttractionForce(const FVec3& BodyLocation, const FVec3& BallLocation, float AttractForce, float Mass)
+	{
+		return (BallLocation - BodyLocation) * (AttractForce * Mass);
+	}
+
+	/** Force that pushes a body away from the ball. Grows linearly with the distance to the center */
+	inline FVec3 RepulsionForce(const FVec3& BodyLocation, const FVec3& BallLocation, float RepulsionForce, float Mass)
+	{
+		return (BodyLocation - BallLocation) * (RepulsionForce * Mass);
+	}
+
+	/** Homing acceleration towards the target, pointing away from it when inverted (used by the repulsion mode) */
+	inline FVec3 HomingAcceleration(const FVec3& TargetLocation, const FVec3& Location, float HomingMagnitude, bool bInverted)
+	{
+		const FVec3 Acceleration = SafeNormal(TargetLocation - Location) * HomingMagnitude;
+		return bInverted ? -Acceleration : Acceleration;
+	}
+
+	/** Linear falloff: the force grows with the distance to the center and is strongest at the rim (the original behaviour) */
+	struct FLinearFalloff
+	{
+		inline float Scale(float /*DistanceSquared*/) const
+		{
+			return 1.f;
+		}
+	};
+
+	/** Constant falloff: the same magnitude everywhere in the area, matching the linear falloff at the rim */
+	struct FConstantFalloff
+	{
+		float Radius;
+
+		inline float Scale(float DistanceSquared) const
+		{
+			return DistanceSquared < SmallNumber ? 0.f : Radius / std::sqrt(DistanceSquared);
+		}
+	};
+
+	/** Inverse square falloff, softened so the force stays finite close to the center */
+	struct FInverseSquareFalloff
+	{
+		float Radius;
+		float SofteningRadius;
+
+		inline float Scale(float DistanceSquared) const
+		{
+			if (DistanceSquared < SmallNumber)
+			{
+				return 0.f;
+			}
+			const float Distance = std::sqrt(DistanceSquared);
+			return (Radius * Radius * Radius) / ((DistanceSquared + SofteningRadius * SofteningRadius) * Distance);
+		}
+	};
+
+	/** Falloff read from a table sampled uniformly over the normalized distance [0, 1] (baked from a curve asset) */
+	struct FTableFalloff
+	{
+		const float* Table;
+		int32_t Num;
+		float Radius;
+
+		inline float Scale(float DistanceSquared) const
+		{
+			if (DistanceSquared < SmallNumber || Num <= 0)
+			{
+				return 0.f;
+			}
+			const float Distance = std::sqrt(DistanceSquared);
+			float Position = (Distance / Radius) * (Num - 1);
+			Position = Position < 0.f ? 0.f : (Position > Num - 1 ? float(Num - 1) : Position);
+			const int32_t Index = int32_t(Position);
+			const int32_t NextIndex = Index + 1 < Num ? Index + 1 : Index;
+			const float Alpha = Position - Index;
+			const float Value = Table[Index] + (Table[NextIndex] - Table[Index]) * Alpha;
+			return Radius * Value / Distance;
+		}
+	};
+
+	/**
+	 * Batched attraction (bRepel = false) or repulsion (bRepel = true) over a packed array of bodies.
+	 * The falloff is a template parameter so every mode/falloff pair gets its own branch free inner loop.
+	 * OutForces must have room for Count elements.
+	 */
+	template<typename TFalloff, bool bRepel>
+	inline void RadialForceKernel(const FVec3* BodyLocations, const float* Masses, int32_t Count, const FVec3& BallLocation, float Force, const TFalloff& Falloff, FVec3* OutForces)
+	{
+		const float SignedForce = bRepel ? Force : -Force;
+		for (int32_t i = 0; i < Count; i++)
+		{
+			const FVec3 Offset = BodyLocations[i] - BallLocation;
+			OutForces[i] = Offset * (SignedForce * Masses[i] * Falloff.Scale(SizeSquared(Offset)));
+		}
+	}
+}
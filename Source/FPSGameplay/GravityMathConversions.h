@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GravityMath.h"
+
+static_assert(sizeof(GravityMath::FVec3) == sizeof(FVector), "GravityMath::FVec3 must stay layout compatible with FVector");
+
+/** Converts an engine vector to the engine independent gravity math vector */
+FORCEINLINE GravityMath::FVec3 ToGravityVec(const FVector& V)
+{
+	return GravityMath::FVec3(V.X, V.Y, V.Z);
+}
+
+/** Converts a gravity math vector back to an engine vector */
+FORCEINLINE FVector ToFVector(const GravityMath::FVec3& V)
+{
+	return FVector(V.X, V.Y, V.Z);
+}
@@ -0,0 +1,96 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityVisualsSubsystem.h"
+#include "Components/SceneComponent.h"
+#include "Curves/CurveFloat.h"
+#include "Materials/MaterialInstanceDynamic.h"
+
+float UGravityVisualsSubsystem::GetAlpha(float Time, float Duration, const UCurveFloat* Curve)
+{
+	const float normalizedTime = Duration > 0.f ? FMath::Clamp(Time / Duration, 0.f, 1.f) : 1.f;
+	return Curve ? Curve->GetFloatValue(normalizedTime) : normalizedTime;
+}
+
+void UGravityVisualsSubsystem::PlayScale(USceneComponent* Component, const FVector& From, const FVector& To, float Duration, UCurveFloat* Curve)
+{
+	if (!Component)
+	{
+		return;
+	}
+
+	ScaleAnimations.RemoveAllSwap([Component](const FGravityScaleAnimation& animation) { return animation.Component == Component; }, false);
+
+	FGravityScaleAnimation& animation = ScaleAnimations.AddDefaulted_GetRef();
+	animation.Component = Component;
+	animation.From = From;
+	animation.To = To;
+	animation.Time = 0.f;
+	animation.Duration = Duration;
+	animation.Curve = Curve;
+
+	Component->SetRelativeScale3D(From);
+}
+
+void UGravityVisualsSubsystem::PlayColorBlend(UMaterialInstanceDynamic* Material, FName Parameter, const FLinearColor& From, const FLinearColor& To, float Duration, UCurveFloat* Curve)
+{
+	if (!Material)
+	{
+		return;
+	}
+
+	ColorBlends.RemoveAllSwap([Material, Parameter](const FGravityColorBlend& blend) { return blend.Material == Material && blend.Parameter == Parameter; }, false);
+
+	FGravityColorBlend& blend = ColorBlends.AddDefaulted_GetRef();
+	blend.Material = Material;
+	blend.Parameter = Parameter;
+	blend.From = From;
+	blend.To = To;
+	blend.Time = 0.f;
+	blend.Duration = Duration;
+	blend.Curve = Curve;
+
+	Material->SetVectorParameterValue(Parameter, From);
+}
+
+void UGravityVisualsSubsystem::Tick(float DeltaTime)
+{
+	// finished or dead animations are swapped out, the order doesn't matter
+	for (int32 i = ScaleAnimations.Num() - 1; i >= 0; i--)
+	{
+		FGravityScaleAnimation& animation = ScaleAnimations[i];
+		USceneComponent* component = animation.Component.Get();
+		if (!component)
+		{
+			ScaleAnimations.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		animation.Time += DeltaTime;
+		component->SetRelativeScale3D(FMath::Lerp(animation.From, animation.To, GetAlpha(animation.Time, animation.Duration, animation.Curve.Get())));
+
+		if (animation.Time >= animation.Duration)
+		{
+			ScaleAnimations.RemoveAtSwap(i, 1, false);
+		}
+	}
+
+	for (int32 i = ColorBlends.Num() - 1; i >= 0; i--)
+	{
+		FGravityColorBlend& blend = ColorBlends[i];
+		UMaterialInstanceDynamic* material = blend.Material.Get();
+		if (!material)
+		{
+			ColorBlends.RemoveAtSwap(i, 1, false);
+			continue;
+		}
+
+		blend.Time += DeltaTime;
+		material->SetVectorParameterValue(blend.Parameter, FMath::Lerp(blend.From, blend.To, GetAlpha(blend.Time, blend.Duration, blend.Curve.Get())));
+
+		if (blend.Time >= blend.Duration)
+		{
+			ColorBlends.RemoveAtSwap(i, 1, false);
+		}
+	}
+}
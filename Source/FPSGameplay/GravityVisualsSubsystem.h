@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "GravityVisualsSubsystem.generated.h"
+
+class UCurveFloat;
+class UMaterialInstanceDynamic;
+
+/** Scale animation of one component */
+struct FGravityScaleAnimation
+{
+	TWeakObjectPtr<USceneComponent> Component;
+	FVector From;
+	FVector To;
+	float Time;
+	float Duration;
+	TWeakObjectPtr<UCurveFloat> Curve;
+};
+
+/** Color parameter blend of one material */
+struct FGravityColorBlend
+{
+	TWeakObjectPtr<UMaterialInstanceDynamic> Material;
+	FName Parameter;
+	FLinearColor From;
+	FLinearColor To;
+	float Time;
+	float Duration;
+	TWeakObjectPtr<UCurveFloat> Curve;
+};
+
+/**
+ * Plays the small visual animations of the gravity balls (scale pops and material color blends) natively.
+ * One updater for every ball, and it only ticks while there's an animation playing.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UGravityVisualsSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	/**
+	 * Animates the relative scale of a component, replacing any scale animation it was playing.
+	 * @param Curve		maps the normalized time to the blend alpha, linear if null
+	 */
+	void PlayScale(USceneComponent* Component, const FVector& From, const FVector& To, float Duration, UCurveFloat* Curve = nullptr);
+
+	/** Blends a vector parameter of a material, replacing any blend of the same parameter */
+	void PlayColorBlend(UMaterialInstanceDynamic* Material, FName Parameter, const FLinearColor& From, const FLinearColor& To, float Duration, UCurveFloat* Curve = nullptr);
+
+	/** Number of animations playing */
+	int32 GetNumActiveAnimations() const { return ScaleAnimations.Num() + ColorBlends.Num(); }
+
+	// FTickableGameObject interface
+	virtual void Tick(float DeltaTime) override;
+	virtual bool IsTickable() const override { return GetNumActiveAnimations() > 0; }
+	virtual ETickableTickType GetTickableTickType() const override { return ETickableTickType::Conditional; }
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual TStatId GetStatId() const override { RETURN_QUICK_DECLARE_CYCLE_STAT(UGravityVisualsSubsystem, STATGROUP_Tickables); }
+	// End of FTickableGameObject interface
+
+private:
+	static float GetAlpha(float Time, float Duration, const UCurveFloat* Curve);
+
+	TArray<FGravityScaleAnimation> ScaleAnimations;
+	TArray<FGravityColorBlend> ColorBlends;
+};
@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HookAnchorComponent.h"
+#include "HookAnchorSubsystem.h"
+#include "Engine/World.h"
+
+// Sets default values for this component's properties
+UHookAnchorComponent::UHookAnchorComponent()
+{
+	PrimaryComponentTick.bCanEverTick = false;
+	bWantsOnUpdateTransform = true;
+
+	bIsHookable = true;
+	AnchorHandle = INDEX_NONE;
+}
+
+// Called when the game starts
+void UHookAnchorComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UHookAnchorSubsystem* anchors = GetWorld()->GetSubsystem<UHookAnchorSubsystem>())
+	{
+		AnchorHandle = anchors->AddAnchor(GetComponentLocation(), this);
+		anchors->SetAnchorEnabled(AnchorHandle, bIsHookable);
+	}
+}
+
+void UHookAnchorComponent::SetHookable(bool bNewHookable)
+{
+	bIsHookable = bNewHookable;
+
+	if (AnchorHandle != INDEX_NONE)
+	{
+		if (UHookAnchorSubsystem* anchors = GetWorld()->GetSubsystem<UHookAnchorSubsystem>())
+		{
+			anchors->SetAnchorEnabled(AnchorHandle, bIsHookable);
+		}
+	}
+}
+
+void UHookAnchorComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AnchorHandle != INDEX_NONE)
+	{
+		if (UHookAnchorSubsystem* anchors = GetWorld()->GetSubsystem<UHookAnchorSubsystem>())
+		{
+			anchors->RemoveAnchor(AnchorHandle);
+		}
+		AnchorHandle = INDEX_NONE;
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void UHookAnchorComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	Super::OnUpdateTransform(UpdateTransformFlags, Teleport);
+
+	if (AnchorHandle != INDEX_NONE)
+	{
+		if (UHookAnchorSubsystem* anchors = GetWorld()->GetSubsystem<UHookAnchorSubsystem>())
+		{
+			anchors->UpdateAnchor(AnchorHandle, GetComponentLocation());
+		}
+	}
+}
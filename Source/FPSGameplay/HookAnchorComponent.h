@@ -0,0 +1,40 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/SceneComponent.h"
+#include "HookAnchorComponent.generated.h"
+
+/** Point the gravity hook can attach to. Place it on any actor in the level, it registers itself in the hook anchor index */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class FPSGAMEPLAY_API UHookAnchorComponent : public USceneComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UHookAnchorComponent();
+
+	/** True if the anchor can be hooked right now */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Hook)
+		bool bIsHookable;
+
+	/** Enables or disables hooking to this anchor */
+	UFUNCTION(BlueprintCallable, Category = Hook)
+		void SetHookable(bool bNewHookable);
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	// Called when the game ends or the component is destroyed
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/** Keeps the anchor index up to date when the owner moves */
+	virtual void OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport) override;
+
+private:
+	/** Handle of this anchor in the hook anchor index, INDEX_NONE when not registered */
+	int32 AnchorHandle;
+};
@@ -0,0 +1,263 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HookAnchorSubsystem.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "Components/SceneComponent.h"
+#include "FPSGameplayMemory.h"
+#include "FPSGameplayCharacter.h"
+
+const FName UHookAnchorSubsystem::AutoAnchorTag(TEXT("HookAnchor"));
+
+UHookAnchorSubsystem::UHookAnchorSubsystem()
+{
+	CellSize = 1.f;
+	bAutoAnchorsBuilt = false;
+}
+
+void UHookAnchorSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	// twice the default MaxHookRange of the character, FindBestAnchor grows it for the characters that reach further
+	CellSize = FMath::Max(2.f * GetDefault<AFPSGameplayCharacter>()->MaxHookRange, 1.f);
+}
+
+void UHookAnchorSubsystem::Deinitialize()
+{
+	if (ActorSpawnedHandle.IsValid())
+	{
+		GetWorld()->RemoveOnActorSpawnedHandler(ActorSpawnedHandle);
+		ActorSpawnedHandle.Reset();
+	}
+	AutoAnchors.Reset();
+	Anchors.Reset();
+	FreeHandles.Reset();
+	Cells.Reset();
+
+	Super::Deinitialize();
+}
+
+FIntVector UHookAnchorSubsystem::GetCell(const FVector& Location) const
+{
+	return FIntVector(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize), FMath::FloorToInt(Location.Z / CellSize));
+}
+
+int32 UHookAnchorSubsystem::AddAnchor(const FVector& Location, USceneComponent* Component)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	int32 handle;
+	if (FreeHandles.Num() > 0)
+	{
+		handle = FreeHandles.Pop(false);
+	}
+	else
+	{
+		handle = Anchors.AddDefaulted();
+	}
+
+	FHookAnchor& anchor = Anchors[handle];
+	anchor.Location = Location;
+	anchor.Cell = GetCell(Location);
+	anchor.Component = Component;
+	anchor.LocalOffset = Component ? Component->GetComponentTransform().InverseTransformPosition(Location) : FVector::ZeroVector;
+	anchor.bEnabled = true;
+	anchor.bInUse = true;
+
+	Cells.FindOrAdd(anchor.Cell).Add(handle);
+	return handle;
+}
+
+void UHookAnchorSubsystem::RemoveAnchor(int32 Handle)
+{
+	if (!Anchors.IsValidIndex(Handle) || !Anchors[Handle].bInUse)
+	{
+		return;
+	}
+
+	FHookAnchor& anchor = Anchors[Handle];
+	if (TArray<int32>* cell = Cells.Find(anchor.Cell))
+	{
+		cell->RemoveSingleSwap(Handle, false);
+	}
+	anchor.bInUse = false;
+	anchor.Component = nullptr;
+	FreeHandles.Add(Handle);
+}
+
+void UHookAnchorSubsystem::UpdateAnchor(int32 Handle, const FVector& NewLocation)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	if (!Anchors.IsValidIndex(Handle) || !Anchors[Handle].bInUse)
+	{
+		return;
+	}
+
+	FHookAnchor& anchor = Anchors[Handle];
+	anchor.Location = NewLocation;
+
+	const FIntVector newCell = GetCell(NewLocation);
+	if (newCell != anchor.Cell)
+	{
+		if (TArray<int32>* cell = Cells.Find(anchor.Cell))
+		{
+			cell->RemoveSingleSwap(Handle, false);
+		}
+		anchor.Cell = newCell;
+		Cells.FindOrAdd(newCell).Add(Handle);
+	}
+}
+
+void UHookAnchorSubsystem::SetAnchorEnabled(int32 Handle, bool bEnabled)
+{
+	if (Anchors.IsValidIndex(Handle))
+	{
+		Anchors[Handle].bEnabled = bEnabled;
+	}
+}
+
+void UHookAnchorSubsystem::SetCellSize(float NewCellSize)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	CellSize = NewCellSize;
+
+	Cells.Reset();
+	for (int32 handle = 0; handle < Anchors.Num(); handle++)
+	{
+		FHookAnchor& anchor = Anchors[handle];
+		if (anchor.bInUse)
+		{
+			anchor.Cell = GetCell(anchor.Location);
+			Cells.FindOrAdd(anchor.Cell).Add(handle);
+		}
+	}
+}
+
+FVector UHookAnchorSubsystem::GetAnchorLocation(int32 Handle) const
+{
+	return Anchors.IsValidIndex(Handle) ? Anchors[Handle].Location : FVector::ZeroVector;
+}
+
+void UHookAnchorSubsystem::BuildAutoAnchors()
+{
+	bAutoAnchorsBuilt = true;
+
+	for (TActorIterator<AActor> it(GetWorld()); it; ++it)
+	{
+		AddAutoAnchor(*it);
+	}
+
+	ActorSpawnedHandle = GetWorld()->AddOnActorSpawnedHandler(FOnActorSpawned::FDelegate::CreateUObject(this, &UHookAnchorSubsystem::OnActorSpawned));
+}
+
+void UHookAnchorSubsystem::AddAutoAnchor(AActor* Actor)
+{
+	USceneComponent* root = Actor->GetRootComponent();
+	if (!root || !Actor->ActorHasTag(AutoAnchorTag) || AutoAnchors.Contains(root))
+	{
+		return;
+	}
+
+	FVector origin, extent;
+	Actor->GetActorBounds(true, origin, extent);
+	AutoAnchors.Add(root, AddAnchor(origin + FVector(0.f, 0.f, extent.Z), root));
+
+	// static actors never move, only the movable ones need to be followed
+	if (root->Mobility == EComponentMobility::Movable)
+	{
+		root->TransformUpdated.AddUObject(this, &UHookAnchorSubsystem::OnAutoAnchorMoved);
+	}
+}
+
+void UHookAnchorSubsystem::OnActorSpawned(AActor* Actor)
+{
+	AddAutoAnchor(Actor);
+}
+
+void UHookAnchorSubsystem::OnAutoAnchorMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (const int32* handle = AutoAnchors.Find(Component))
+	{
+		UpdateAnchor(*handle, Component->GetComponentTransform().TransformPosition(Anchors[*handle].LocalOffset));
+	}
+}
+
+int32 UHookAnchorSubsystem::FindBestAnchor(const FVector& ViewLocation, const FVector& ViewDirection, float MaxRange, float ConeHalfAngleDegrees, FVector& OutLocation)
+{
+	if (!bAutoAnchorsBuilt)
+	{
+		BuildAutoAnchors();
+	}
+
+	// the query box has to fit in 2x2x2 cells
+	if (2.f * MaxRange > CellSize)
+	{
+		SetCellSize(2.f * MaxRange);
+	}
+
+	const float maxRangeSquared = MaxRange * MaxRange;
+	const float minCos = FMath::Cos(FMath::DegreesToRadians(ConeHalfAngleDegrees));
+	const FIntVector minCell = GetCell(ViewLocation - FVector(MaxRange));
+	const FIntVector maxCell = GetCell(ViewLocation + FVector(MaxRange));
+
+	int32 bestHandle = INDEX_NONE;
+	float bestScore = -MAX_FLT;
+
+	for (int32 x = minCell.X; x <= maxCell.X; x++)
+	{
+		for (int32 y = minCell.Y; y <= maxCell.Y; y++)
+		{
+			for (int32 z = minCell.Z; z <= maxCell.Z; z++)
+			{
+				const TArray<int32>* cell = Cells.Find(FIntVector(x, y, z));
+				if (!cell)
+				{
+					continue;
+				}
+
+				for (int32 handle : *cell)
+				{
+					// anchors of destroyed actors stay in the grid but can't be hooked
+					const FHookAnchor& anchor = Anchors[handle];
+					if (!anchor.bEnabled || anchor.Component.IsStale())
+					{
+						continue;
+					}
+
+					const FVector toAnchor = anchor.Location - ViewLocation;
+					const float distanceSquared = toAnchor.SizeSquared();
+					if (distanceSquared > maxRangeSquared || distanceSquared < KINDA_SMALL_NUMBER)
+					{
+						continue;
+					}
+
+					// cos of the angle between the view and the anchor, without normalizing toAnchor
+					const float distance = FMath::Sqrt(distanceSquared);
+					const float cosAngle = FVector::DotProduct(toAnchor, ViewDirection) / distance;
+					if (cosAngle < minCos)
+					{
+						continue;
+					}
+
+					// anchors in the center of the view win, distance breaks the ties
+					const float score = cosAngle - 0.25f * (distance / MaxRange);
+					if (score > bestScore)
+					{
+						bestScore = score;
+						bestHandle = handle;
+					}
+				}
+			}
+		}
+	}
+
+	if (bestHandle != INDEX_NONE)
+	{
+		OutLocation = Anchors[bestHandle].Location;
+	}
+	return bestHandle;
+}
@@ -0,0 +1,95 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "HookAnchorSubsystem.generated.h"
+
+/** One entry of the hook anchor index */
+struct FHookAnchor
+{
+	FVector Location;
+	FIntVector Cell;
+	TWeakObjectPtr<USceneComponent> Component;
+	/** Location in the space of Component, for the anchors that follow it */
+	FVector LocalOffset;
+	bool bEnabled;
+	bool bInUse;
+};
+
+/**
+ * Level wide spatial index of the points the gravity hook can attach to.
+ * Anchors are stored in a uniform hash grid whose cells are at least twice as big as the hook range:
+ * the query box is two ranges wide, so it never spans more than 2x2x2 cells. A query with a longer range grows the cells.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UHookAnchorSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UHookAnchorSubsystem();
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Actors with this tag get an anchor generated on top of their bounds */
+	static const FName AutoAnchorTag;
+
+	/** Adds an anchor to the index and returns its handle */
+	int32 AddAnchor(const FVector& Location, USceneComponent* Component = nullptr);
+
+	/** Removes an anchor from the index, the handle can be reused afterwards */
+	void RemoveAnchor(int32 Handle);
+
+	/** Moves an anchor. Only touches the grid when it changes cell */
+	void UpdateAnchor(int32 Handle, const FVector& NewLocation);
+
+	/** Enables or disables an anchor without removing it from the index */
+	void SetAnchorEnabled(int32 Handle, bool bEnabled);
+
+	/**
+	 * Finds the anchor closest to the center of the view cone, preferring the closer ones.
+	 * @returns the handle of the best anchor or INDEX_NONE if there isn't any in range
+	 */
+	int32 FindBestAnchor(const FVector& ViewLocation, const FVector& ViewDirection, float MaxRange, float ConeHalfAngleDegrees, FVector& OutLocation);
+
+	/** Location of a registered anchor */
+	FVector GetAnchorLocation(int32 Handle) const;
+
+	/**
+	 * Generates the anchors for every actor tagged with AutoAnchorTag. Called automatically before the first query,
+	 * the tagged actors spawned afterwards get theirs when they spawn.
+	 * The anchors follow their actor's root component when it moves
+	 */
+	void BuildAutoAnchors();
+
+	/** Size of the grid cells */
+	float GetCellSize() const { return CellSize; }
+
+	/** Resizes the grid cells and moves every anchor to its new cell. Keep it at least twice the hook range */
+	void SetCellSize(float NewCellSize);
+
+private:
+	FIntVector GetCell(const FVector& Location) const;
+
+	/** Generates the anchor of a tagged actor */
+	void AddAutoAnchor(AActor* Actor);
+
+	void OnActorSpawned(AActor* Actor);
+
+	/** Moves the anchor of a tagged actor with its root component */
+	void OnAutoAnchorMoved(USceneComponent* Component, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/** Anchor of every tagged actor's root component */
+	TMap<TWeakObjectPtr<USceneComponent>, int32> AutoAnchors;
+
+	TArray<FHookAnchor> Anchors;
+	TArray<int32> FreeHandles;
+	TMap<FIntVector, TArray<int32>> Cells;
+	float CellSize;
+
+	FDelegateHandle ActorSpawnedHandle;
+	bool bAutoAnchorsBuilt;
+};
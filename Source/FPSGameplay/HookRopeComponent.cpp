@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HookRopeComponent.h"
+#include "FPSGameplayMemory.h"
+
+void UHookRopeComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	FPS_ALLOC_SCOPE(HookRope);
+
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+}
+
+void UHookRopeComponent::SendRenderDynamicData_Concurrent()
+{
+	// only counted when the end of frame updates run on the game thread
+	FPS_ALLOC_SCOPE(HookRopeRender);
+
+	Super::SendRenderDynamicData_Concurrent();
+}
@@ -0,0 +1,20 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "CableComponent.h"
+#include "HookRopeComponent.generated.h"
+
+/** Cable of the gravity hook. Runs the cable simulation inside the HookRope allocation scope and its render data updates inside HookRopeRender */
+UCLASS(ClassGroup = (Custom))
+class FPSGAMEPLAY_API UHookRopeComponent : public UCableComponent
+{
+	GENERATED_BODY()
+
+public:
+	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	/** Builds the new particle positions for the render thread, which rebuilds the cable mesh from them */
+	virtual void SendRenderDynamicData_Concurrent() override;
+};
@@ -0,0 +1,173 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileRenderSubsystem.h"
+#include "FPSGameplayProjectile.h"
+#include "Components/HierarchicalInstancedStaticMeshComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "FPSGameplayMemory.h"
+
+static TAutoConsoleVariable<int32> CVarProjectileInstancedRendering(
+	TEXT("fps.Projectiles.InstancedRendering"),
+	0,
+	TEXT("1 draws the projectiles spawned from now on as instances of a shared hierarchical instanced static mesh. The materials need Used with Instanced Static Meshes"));
+
+static FAutoConsoleCommandWithWorld ProjectileRenderStatsCommand(
+	TEXT("fps.Projectiles.RenderStats"),
+	TEXT("Logs the instanced projectile counters since the last call: skipped registrations, bulk updates and instance transform updates"),
+	FConsoleCommandWithWorldDelegate::CreateLambda([](UWorld* World)
+	{
+		if (UProjectileRenderSubsystem* projectileRender = World->GetSubsystem<UProjectileRenderSubsystem>())
+		{
+			projectileRender->ReportStats();
+		}
+	}));
+
+void FProjectileRenderTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->UpdateInstances();
+	}
+}
+
+FString FProjectileRenderTickFunction::DiagnosticMessage()
+{
+	return TEXT("FProjectileRenderTickFunction");
+}
+
+bool UProjectileRenderSubsystem::IsInstancedRenderingEnabled()
+{
+	return CVarProjectileInstancedRendering.GetValueOnGameThread() != 0;
+}
+
+void UProjectileRenderSubsystem::Deinitialize()
+{
+	if (RenderTickFunction.IsTickFunctionRegistered())
+	{
+		RenderTickFunction.UnRegisterTickFunction();
+	}
+	Groups.Reset();
+	GroupIndices.Reset();
+	Instances.Reset();
+
+	Super::Deinitialize();
+}
+
+void UProjectileRenderSubsystem::AddProjectile(AFPSGameplayProjectile* Projectile, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshTransform)
+{
+	FPS_LLM_SCOPE(Projectiles);
+
+	if (!Projectile || !Mesh || Instances.Contains(Projectile))
+	{
+		return;
+	}
+
+	// the proxy actor and the tick function are created with the first projectile, the level is guaranteed to exist by then
+	if (!ProxyActor)
+	{
+		FActorSpawnParameters spawnParams;
+		spawnParams.Name = TEXT("ProjectileRenderProxy");
+		spawnParams.ObjectFlags = RF_Transient;
+		ProxyActor = GetWorld()->SpawnActor<AActor>(spawnParams);
+	}
+	if (!RenderTickFunction.IsTickFunctionRegistered())
+	{
+		RenderTickFunction.Owner = this;
+		RenderTickFunction.bCanEverTick = true;
+		RenderTickFunction.TickGroup = TG_PostPhysics;
+		RenderTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	const TPair<UStaticMesh*, UMaterialInterface*> key(Mesh, Material);
+	int32* groupIndex = GroupIndices.Find(key);
+	if (!groupIndex)
+	{
+		UHierarchicalInstancedStaticMeshComponent* component = NewObject<UHierarchicalInstancedStaticMeshComponent>(ProxyActor);
+		component->SetStaticMesh(Mesh);
+		if (Material)
+		{
+			component->SetMaterial(0, Material);
+		}
+		component->SetMobility(EComponentMobility::Movable);
+		component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+		component->SetGenerateOverlapEvents(false);
+		if (!ProxyActor->GetRootComponent())
+		{
+			ProxyActor->SetRootComponent(component);
+		}
+		component->RegisterComponent();
+
+		FProjectileInstanceGroup& group = Groups.AddDefaulted_GetRef();
+		group.Component = component;
+		groupIndex = &GroupIndices.Add(key, Groups.Num() - 1);
+	}
+
+	FProjectileInstanceGroup& group = Groups[*groupIndex];
+	const FTransform instanceTransform = MeshTransform * Projectile->GetActorTransform();
+	group.Component->AddInstanceWorldSpace(instanceTransform);
+	group.Projectiles.Add(Projectile);
+	group.MeshTransforms.Add(MeshTransform);
+	Instances.Add(Projectile, FIntPoint(*groupIndex, group.Projectiles.Num() - 1));
+}
+
+void UProjectileRenderSubsystem::RemoveProjectile(AFPSGameplayProjectile* Projectile)
+{
+	FIntPoint instance;
+	if (!Instances.RemoveAndCopyValue(Projectile, instance))
+	{
+		return;
+	}
+
+	// the last projectile takes the removed slot and the last instance goes away, so the
+	// instances never get reordered. The next bulk update writes the moved projectile in its new slot
+	FProjectileInstanceGroup& group = Groups[instance.X];
+	group.Projectiles.RemoveAtSwap(instance.Y, 1, false);
+	group.MeshTransforms.RemoveAtSwap(instance.Y, 1, false);
+	if (group.Projectiles.IsValidIndex(instance.Y))
+	{
+		Instances[group.Projectiles[instance.Y]] = instance;
+	}
+	group.Component->RemoveInstance(group.Projectiles.Num());
+}
+
+void UProjectileRenderSubsystem::UpdateInstances()
+{
+	const double startTime = FPlatformTime::Seconds();
+
+	for (FProjectileInstanceGroup& group : Groups)
+	{
+		const int32 numInstances = group.Projectiles.Num();
+		if (numInstances == 0)
+		{
+			continue;
+		}
+
+		group.InstanceTransforms.SetNumUninitialized(numInstances, false);
+		for (int32 i = 0; i < numInstances; i++)
+		{
+			group.InstanceTransforms[i] = group.MeshTransforms[i] * group.Projectiles[i]->GetActorTransform();
+		}
+
+		group.Component->BatchUpdateInstancesTransforms(0, group.InstanceTransforms, true, true, true);
+		NumBulkUpdates++;
+		NumInstanceUpdates += numInstances;
+	}
+
+	NumFrames++;
+	UpdateSeconds += FPlatformTime::Seconds() - startTime;
+}
+
+void UProjectileRenderSubsystem::ReportStats()
+{
+	UE_LOG(LogTemp, Display, TEXT("Projectile rendering: %d instanced projectiles in %d groups. Over %d frames: %d meshes unregistered, %d bulk updates, %lld instance transforms (%.1f per frame), %.3f ms per frame"),
+		Instances.Num(), Groups.Num(), NumFrames, NumSkippedRegistrations, NumBulkUpdates, NumInstanceUpdates,
+		NumFrames > 0 ? (float)NumInstanceUpdates / NumFrames : 0.f, NumFrames > 0 ? UpdateSeconds * 1000.0 / NumFrames : 0.0);
+
+	NumFrames = 0;
+	NumSkippedRegistrations = 0;
+	NumBulkUpdates = 0;
+	NumInstanceUpdates = 0;
+	UpdateSeconds = 0.0;
+}
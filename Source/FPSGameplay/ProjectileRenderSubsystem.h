@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectileRenderSubsystem.generated.h"
+
+class AFPSGameplayProjectile;
+class UHierarchicalInstancedStaticMeshComponent;
+class UMaterialInterface;
+class UProjectileRenderSubsystem;
+class UStaticMesh;
+
+/** Projectiles drawn with the same mesh and material, one instance each */
+struct FProjectileInstanceGroup
+{
+	UHierarchicalInstancedStaticMeshComponent* Component = nullptr;
+
+	/** Instance i is Projectiles[i], with its mesh at MeshTransforms[i] relative to the projectile */
+	TArray<AFPSGameplayProjectile*> Projectiles;
+	TArray<FTransform> MeshTransforms;
+	TArray<FTransform> InstanceTransforms;
+};
+
+/** Tick function that moves the instances after the projectiles moved */
+struct FProjectileRenderTickFunction : public FTickFunction
+{
+	UProjectileRenderSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Draws the projectiles as instances of one hierarchical instanced static mesh per mesh and material,
+ * instead of a registered mesh component per projectile. Enabled with fps.Projectiles.InstancedRendering,
+ * the collision stays on the projectile's sphere. fps.Projectiles.RenderStats reports the work, -nullrhi is enough to measure it.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UProjectileRenderSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** True if the projectiles spawned now should use the instanced path */
+	static bool IsInstancedRenderingEnabled();
+
+	virtual void Deinitialize() override;
+
+	/** Adds an instance for a projectile */
+	void AddProjectile(AFPSGameplayProjectile* Projectile, UStaticMesh* Mesh, UMaterialInterface* Material, const FTransform& MeshTransform);
+
+	/** Removes the instance of a projectile */
+	void RemoveProjectile(AFPSGameplayProjectile* Projectile);
+
+	/** Counts a mesh component the instanced path took out of the scene */
+	void CountSkippedRegistration() { NumSkippedRegistrations++; }
+
+	/** Writes every instance transform from its projectile, one bulk update per group */
+	void UpdateInstances();
+
+	/** Logs the counters since the last report and resets them */
+	void ReportStats();
+
+private:
+	UPROPERTY(Transient)
+		AActor* ProxyActor;
+
+	TArray<FProjectileInstanceGroup> Groups;
+
+	/** Group of every mesh and material pair */
+	TMap<TPair<UStaticMesh*, UMaterialInterface*>, int32> GroupIndices;
+
+	/** Group and instance of every projectile */
+	TMap<const AFPSGameplayProjectile*, FIntPoint> Instances;
+
+	FProjectileRenderTickFunction RenderTickFunction;
+
+	/** Counters since the last report */
+	int32 NumFrames = 0;
+	int32 NumSkippedRegistrations = 0;
+	int32 NumBulkUpdates = 0;
+	int64 NumInstanceUpdates = 0;
+	double UpdateSeconds = 0.0;
+};
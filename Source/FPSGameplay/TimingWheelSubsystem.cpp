@@ -0,0 +1,220 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TimingWheelSubsystem.h"
+#include "Engine/World.h"
+#include "FPSGameplayMemory.h"
+
+void FTimingWheelTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Owner && TickType != LEVELTICK_ViewportsOnly)
+	{
+		Owner->Advance();
+	}
+}
+
+FString FTimingWheelTickFunction::DiagnosticMessage()
+{
+	return TEXT("FTimingWheelTickFunction");
+}
+
+void UTimingWheelSubsystem::Deinitialize()
+{
+	if (WheelTickFunction.IsTickFunctionRegistered())
+	{
+		WheelTickFunction.UnRegisterTickFunction();
+	}
+	Entries.Reset();
+	FreeEntries.Reset();
+	Expired.Reset();
+	NumScheduled = 0;
+
+	Super::Deinitialize();
+}
+
+uint64 UTimingWheelSubsystem::GetWorldTick() const
+{
+	return (uint64)(GetWorld()->GetTimeSeconds() / TickSeconds);
+}
+
+FTimingWheelHandle UTimingWheelSubsystem::Schedule(float Delay, FSimpleDelegate Callback)
+{
+	FPS_LLM_SCOPE(GravitySystem);
+
+	// the wheel and its tick function start with the first expiration, the level is guaranteed to exist by then
+	if (!bStarted)
+	{
+		bStarted = true;
+		CurrentTick = GetWorldTick();
+		for (int32& head : SlotHeads)
+		{
+			head = INDEX_NONE;
+		}
+
+		WheelTickFunction.Owner = this;
+		WheelTickFunction.bCanEverTick = true;
+		WheelTickFunction.TickGroup = TG_PrePhysics;
+		WheelTickFunction.RegisterTickFunction(GetWorld()->PersistentLevel);
+	}
+
+	int32 index;
+	if (FreeEntries.Num() > 0)
+	{
+		index = FreeEntries.Pop(false);
+	}
+	else
+	{
+		index = Entries.AddDefaulted();
+	}
+
+	// never in the tick being processed, the earliest is the next one
+	FEntry& entry = Entries[index];
+	entry.Callback = MoveTemp(Callback);
+	entry.ExpireTick = FMath::Max(CurrentTick + 1, (uint64)((GetWorld()->GetTimeSeconds() + FMath::Max(Delay, 0.f)) / TickSeconds));
+	Link(index);
+	NumScheduled++;
+
+	FTimingWheelHandle handle;
+	handle.Index = index;
+	handle.Serial = entry.Serial;
+	return handle;
+}
+
+bool UTimingWheelSubsystem::IsHandleScheduled(const FTimingWheelHandle& Handle) const
+{
+	return Handle.IsValid() && Entries.IsValidIndex(Handle.Index) && Entries[Handle.Index].Serial == Handle.Serial && Entries[Handle.Index].Slot != INDEX_NONE;
+}
+
+void UTimingWheelSubsystem::Cancel(FTimingWheelHandle& Handle)
+{
+	if (IsHandleScheduled(Handle))
+	{
+		Unlink(Handle.Index);
+
+		FEntry& entry = Entries[Handle.Index];
+		entry.Callback.Unbind();
+		entry.Serial++;
+		FreeEntries.Add(Handle.Index);
+		NumScheduled--;
+	}
+	Handle.Invalidate();
+}
+
+float UTimingWheelSubsystem::GetTimeRemaining(const FTimingWheelHandle& Handle) const
+{
+	if (!IsHandleScheduled(Handle))
+	{
+		return 0.f;
+	}
+	return FMath::Max(0.f, Entries[Handle.Index].ExpireTick * TickSeconds - GetWorld()->GetTimeSeconds());
+}
+
+void UTimingWheelSubsystem::Link(int32 Index)
+{
+	FEntry& entry = Entries[Index];
+
+	// level 0 has one slot per tick, each slot of level 1 covers a whole turn of level 0 and so on
+	const uint64 delta = entry.ExpireTick - CurrentTick;
+	int32 slot;
+	if (delta < Level0Slots)
+	{
+		slot = entry.ExpireTick & (Level0Slots - 1);
+	}
+	else if (delta < ((uint64)1 << (Level0Bits + LevelBits)))
+	{
+		slot = Level0Slots + ((entry.ExpireTick >> Level0Bits) & (LevelSlots - 1));
+	}
+	else
+	{
+		// past the end of the wheel the expiration is clamped to the last slot
+		const uint64 maxDelta = ((uint64)1 << (Level0Bits + 2 * LevelBits)) - 1;
+		entry.ExpireTick = CurrentTick + FMath::Min(delta, maxDelta);
+		slot = Level0Slots + LevelSlots + ((entry.ExpireTick >> (Level0Bits + LevelBits)) & (LevelSlots - 1));
+	}
+
+	entry.Slot = slot;
+	entry.Prev = INDEX_NONE;
+	entry.Next = SlotHeads[slot];
+	if (entry.Next != INDEX_NONE)
+	{
+		Entries[entry.Next].Prev = Index;
+	}
+	SlotHeads[slot] = Index;
+}
+
+void UTimingWheelSubsystem::Unlink(int32 Index)
+{
+	FEntry& entry = Entries[Index];
+	if (entry.Prev != INDEX_NONE)
+	{
+		Entries[entry.Prev].Next = entry.Next;
+	}
+	else
+	{
+		SlotHeads[entry.Slot] = entry.Next;
+	}
+	if (entry.Next != INDEX_NONE)
+	{
+		Entries[entry.Next].Prev = entry.Prev;
+	}
+	entry.Prev = INDEX_NONE;
+	entry.Next = INDEX_NONE;
+	entry.Slot = INDEX_NONE;
+}
+
+void UTimingWheelSubsystem::Cascade(int32 Slot)
+{
+	int32 index = SlotHeads[Slot];
+	SlotHeads[Slot] = INDEX_NONE;
+	while (index != INDEX_NONE)
+	{
+		const int32 next = Entries[index].Next;
+		Link(index);
+		index = next;
+	}
+}
+
+void UTimingWheelSubsystem::Advance()
+{
+	const uint64 targetTick = GetWorldTick();
+	while (CurrentTick < targetTick)
+	{
+		CurrentTick++;
+
+		// every full turn of a level pulls the next slot of the level above down
+		if ((CurrentTick & (Level0Slots - 1)) == 0)
+		{
+			const uint64 level1Index = (CurrentTick >> Level0Bits) & (LevelSlots - 1);
+			if (level1Index == 0)
+			{
+				Cascade(Level0Slots + LevelSlots + ((CurrentTick >> (Level0Bits + LevelBits)) & (LevelSlots - 1)));
+			}
+			Cascade(Level0Slots + level1Index);
+		}
+
+		const int32 slot = CurrentTick & (Level0Slots - 1);
+		int32 index = SlotHeads[slot];
+		while (index != INDEX_NONE)
+		{
+			const int32 next = Entries[index].Next;
+			Unlink(index);
+			Expired.Add(index);
+			index = next;
+		}
+	}
+
+	// fire the whole batch. The entries are released after their callback so a callback cancelling
+	// a handle that expired in the same frame doesn't touch a reused entry
+	for (int32 i = 0; i < Expired.Num(); i++)
+	{
+		FEntry& entry = Entries[Expired[i]];
+		FSimpleDelegate callback = MoveTemp(entry.Callback);
+		entry.Callback.Unbind();
+		entry.Serial++;
+		NumScheduled--;
+
+		callback.ExecuteIfBound();
+	}
+	FreeEntries.Append(Expired);
+	Expired.Reset();
+}
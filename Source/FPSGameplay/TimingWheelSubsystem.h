@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TimingWheelSubsystem.generated.h"
+
+class UTimingWheelSubsystem;
+
+/** Handle to a scheduled expiration. Stays safe to use after the expiration fired or was cancelled */
+struct FTimingWheelHandle
+{
+	int32 Index = INDEX_NONE;
+	uint32 Serial = 0;
+
+	bool IsValid() const { return Index != INDEX_NONE; }
+	void Invalidate() { Index = INDEX_NONE; }
+};
+
+/** Tick function that fires the expirations of the frame */
+struct FTimingWheelTickFunction : public FTickFunction
+{
+	UTimingWheelSubsystem* Owner = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override;
+};
+
+/**
+ * Hierarchical timing wheel for gameplay expirations (projectile lifespans, gravity ball timeouts...).
+ * Scheduling and cancelling are O(1), and everything that expires in a frame is fired in one batch from a single tick function,
+ * instead of one timer manager entry or one countdown per actor.
+ * The wheel runs on world time with a resolution of TickSeconds; three levels of slots cover a bit more than 9 hours.
+ */
+UCLASS()
+class FPSGAMEPLAY_API UTimingWheelSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	/** Length of a tick of the wheel, the expirations fire on the first frame after their tick */
+	static constexpr float TickSeconds = 1.f / 32.f;
+
+	virtual void Deinitialize() override;
+
+	/** Calls Callback once, Delay seconds from now */
+	FTimingWheelHandle Schedule(float Delay, FSimpleDelegate Callback);
+
+	/** Cancels an expiration and invalidates the handle. Does nothing if it already fired */
+	void Cancel(FTimingWheelHandle& Handle);
+
+	/** Seconds until the expiration fires, 0 if it isn't scheduled */
+	float GetTimeRemaining(const FTimingWheelHandle& Handle) const;
+
+	/** Number of expirations waiting to fire */
+	int32 GetNumScheduled() const { return NumScheduled; }
+
+	/** Advances the wheel to the current world time and fires everything that expired */
+	void Advance();
+
+private:
+	static constexpr int32 Level0Bits = 8;
+	static constexpr int32 LevelBits = 6;
+	static constexpr int32 Level0Slots = 1 << Level0Bits;
+	static constexpr int32 LevelSlots = 1 << LevelBits;
+	static constexpr int32 NumSlots = Level0Slots + 2 * LevelSlots;
+
+	struct FEntry
+	{
+		FSimpleDelegate Callback;
+		uint64 ExpireTick = 0;
+		int32 Prev = INDEX_NONE;
+		int32 Next = INDEX_NONE;
+		int32 Slot = INDEX_NONE;
+		uint32 Serial = 0;
+	};
+
+	bool IsHandleScheduled(const FTimingWheelHandle& Handle) const;
+
+	/** Links an entry in the slot matching its expire tick */
+	void Link(int32 Index);
+	void Unlink(int32 Index);
+
+	/** Moves every entry of a higher level slot down to the slots matching their expire tick */
+	void Cascade(int32 Slot);
+
+	uint64 GetWorldTick() const;
+
+	TArray<FEntry> Entries;
+	TArray<int32> FreeEntries;
+
+	/** First entry of every slot: level 0, then level 1, then level 2 */
+	int32 SlotHeads[NumSlots];
+
+	/** Last tick processed */
+	uint64 CurrentTick = 0;
+	bool bStarted = false;
+
+	int32 NumScheduled = 0;
+
+	/** Entries that expired this frame, fired after the wheel is advanced */
+	TArray<int32> Expired;
+
+	FTimingWheelTickFunction WheelTickFunction;
+};
@@ -0,0 +1,199 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryPredictor.h"
+#include "Engine/World.h"
+#include "CollisionQueryParams.h"
+#include "Components/PrimitiveComponent.h"
+#include "GravityMathConversions.h"
+
+FTrajectoryPredictor::FTrajectoryPredictor()
+{
+	NumSteps = 60;
+	StepTime = 1.f / 30.f;
+	LocationTolerance = 5.f;
+	AngleTolerance = 0.5f;
+	bIsValid = false;
+}
+
+const TArray<FVector>& FTrajectoryPredictor::PredictProjectile(UWorld* World, const FTrajectoryLaunchParams& Launch, const AActor* IgnoredActor)
+{
+	if (!World)
+	{
+		Points.Reset();
+		return Points;
+	}
+
+	if (UGravityFieldSubsystem* fields = World->GetSubsystem<UGravityFieldSubsystem>())
+	{
+		fields->GatherActiveFields(Fields);
+	}
+	else
+	{
+		Fields.Reset();
+	}
+
+	// did the aim change enough to throw away the whole prediction?
+	const float cosTolerance = FMath::Cos(FMath::DegreesToRadians(AngleTolerance));
+	const bool bAimChanged = !bIsValid
+		|| FVector::DistSquared(Launch.Location, CachedLaunch.Location) > LocationTolerance * LocationTolerance
+		|| (Launch.Velocity.GetSafeNormal() | CachedLaunch.Velocity.GetSafeNormal()) < cosTolerance
+		|| !FMath::IsNearlyEqual(Launch.Velocity.Size(), CachedLaunch.Velocity.Size(), 1.f)
+		|| Launch.GravityZ != CachedLaunch.GravityZ
+		|| Launch.bShouldBounce != CachedLaunch.bShouldBounce;
+
+	if (bAimChanged)
+	{
+		Points.Reset(NumSteps + 1);
+		Velocities.Reset(NumSteps + 1);
+		Points.Add(Launch.Location);
+		Velocities.Add(Launch.Velocity);
+		Simulate(World, Launch, IgnoredActor, 0);
+
+		CachedLaunch = Launch;
+		CachedFields = Fields;
+		bIsValid = true;
+		return Points;
+	}
+
+	// same aim, only resimulate the part of the path that goes through a field that changed
+	int32 firstChangedStep;
+	if (FieldsChanged(firstChangedStep))
+	{
+		if (firstChangedStep < Points.Num())
+		{
+			Points.SetNum(firstChangedStep + 1, false);
+			Velocities.SetNum(firstChangedStep + 1, false);
+			Simulate(World, CachedLaunch, IgnoredActor, firstChangedStep);
+		}
+		CachedFields = Fields;
+	}
+
+	return Points;
+}
+
+bool FTrajectoryPredictor::FieldsChanged(int32& OutFirstStep) const
+{
+	OutFirstStep = Points.Num();
+	bool bChanged = false;
+
+	// a changed field affects the path from the first point inside its old or new area
+	auto FirstStepInside = [this](const FGravityFieldState& Field)
+	{
+		const float radiusSquared = FMath::Square(Field.Radius + LocationTolerance);
+		for (int32 i = 0; i < Points.Num(); i++)
+		{
+			if (FVector::DistSquared(Points[i], Field.Location) < radiusSquared)
+			{
+				return FMath::Max(i - 1, 0);
+			}
+		}
+		return Points.Num();
+	};
+
+	const int32 numFields = FMath::Max(Fields.Num(), CachedFields.Num());
+	for (int32 i = 0; i < numFields; i++)
+	{
+		const FGravityFieldState* oldField = CachedFields.IsValidIndex(i) ? &CachedFields[i] : nullptr;
+		const FGravityFieldState* newField = Fields.IsValidIndex(i) ? &Fields[i] : nullptr;
+
+		if (oldField && newField
+			&& FVector::DistSquared(oldField->Location, newField->Location) <= LocationTolerance * LocationTolerance
+			&& FMath::IsNearlyEqual(oldField->Radius, newField->Radius, LocationTolerance)
+			&& oldField->HomingAcceleration == newField->HomingAcceleration
+			&& oldField->bInverted == newField->bInverted)
+		{
+			continue;
+		}
+
+		bChanged = true;
+		if (oldField)
+		{
+			OutFirstStep = FMath::Min(OutFirstStep, FirstStepInside(*oldField));
+		}
+		if (newField)
+		{
+			OutFirstStep = FMath::Min(OutFirstStep, FirstStepInside(*newField));
+		}
+	}
+
+	return bChanged;
+}
+
+void FTrajectoryPredictor::Simulate(UWorld* World, const FTrajectoryLaunchParams& Launch, const AActor* IgnoredActor, int32 StartStep)
+{
+	static const FName TraceTag(TEXT("TrajectoryPrediction"));
+	static const FName ProjectileProfile(TEXT("Projectile"));
+
+	FCollisionQueryParams queryParams(TraceTag, false, IgnoredActor);
+	const FCollisionShape sphere = FCollisionShape::MakeSphere(Launch.CollisionRadius);
+
+	FVector location = Points[StartStep];
+	FVector velocity = Velocities[StartStep];
+
+	for (int32 step = StartStep + 1; step <= NumSteps; step++)
+	{
+		// same acceleration the projectile movement component computes: gravity plus the homing of every field we are in
+		GravityMath::FVec3 acceleration(0.f, 0.f, Launch.GravityZ);
+		const GravityMath::FVec3 position = ToGravityVec(location);
+		for (const FGravityFieldState& field : Fields)
+		{
+			if (FVector::DistSquared(location, field.Location) < field.Radius * field.Radius)
+			{
+				acceleration += GravityMath::HomingAcceleration(ToGravityVec(field.Location), position, field.HomingAcceleration, field.bInverted);
+			}
+		}
+
+		velocity += ToFVector(acceleration) * StepTime;
+		if (Launch.MaxSpeed > 0.f)
+		{
+			velocity = velocity.GetClampedToMaxSize(Launch.MaxSpeed);
+		}
+
+		const FVector newLocation = location + velocity * StepTime;
+		FHitResult hit;
+		if (World->SweepSingleByProfile(hit, location, newLocation, FQuat::Identity, ProjectileProfile, sphere, queryParams))
+		{
+			location = hit.Location;
+			Points.Add(location);
+
+			// the projectile is destroyed when it hits a physics body, and stops on anything when it doesn't bounce
+			UPrimitiveComponent* hitComponent = hit.GetComponent();
+			if (!Launch.bShouldBounce || (hitComponent && hitComponent->IsSimulatingPhysics()))
+			{
+				Velocities.Add(FVector::ZeroVector);
+				break;
+			}
+
+			const FVector normalVelocity = hit.Normal * FVector::DotProduct(velocity, hit.Normal);
+			const FVector tangentVelocity = velocity - normalVelocity;
+			velocity = tangentVelocity * (1.f - Launch.Friction) - normalVelocity * Launch.Bounciness;
+			Velocities.Add(velocity);
+		}
+		else
+		{
+			location = newLocation;
+			Points.Add(location);
+			Velocities.Add(velocity);
+		}
+	}
+}
+
+void FTrajectoryPredictor::PredictGravityBall(UWorld* World, const FVector& Location, const FVector& Direction, float MaxDistance, const AActor* IgnoredActor, TArray<FVector>& OutPoints)
+{
+	static const FName TraceTag(TEXT("GravityBallPrediction"));
+
+	OutPoints.Reset(2);
+	OutPoints.Add(Location);
+
+	if (!World)
+	{
+		return;
+	}
+
+	// the ball flies in a straight line and isn't bent by the fields, so one trace is enough
+	const FVector end = Location + Direction.GetSafeNormal() * MaxDistance;
+	FHitResult hit;
+	FCollisionQueryParams queryParams(TraceTag, false, IgnoredActor);
+	OutPoints.Add(World->LineTraceSingleByChannel(hit, Location, end, ECC_Visibility, queryParams) ? hit.Location : end);
+}
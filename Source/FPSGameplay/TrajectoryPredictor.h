@@ -0,0 +1,81 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GravityFieldSubsystem.h"
+
+class UWorld;
+class AActor;
+
+/** Launch parameters of a predicted shot, taken from the projectile movement component defaults */
+struct FTrajectoryLaunchParams
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+	float GravityZ = 0.f;
+	float MaxSpeed = 0.f;
+	bool bShouldBounce = false;
+	float Bounciness = 0.6f;
+	float Friction = 0.2f;
+	float CollisionRadius = 5.f;
+};
+
+/**
+ * Predicts the path of a projectile (with bounces) through every active gravity field.
+ * The result is cached: it is only recomputed when the aim moves beyond a threshold, and when only the fields change
+ * the path is resimulated from the first step that went through a field that changed.
+ */
+class FPSGAMEPLAY_API FTrajectoryPredictor
+{
+public:
+	FTrajectoryPredictor();
+
+	/** Number of simulated steps */
+	int32 NumSteps;
+
+	/** Simulated time per step, in seconds */
+	float StepTime;
+
+	/** Distance the launch location (or a field) has to move before the prediction is recomputed */
+	float LocationTolerance;
+
+	/** Angle in degrees the launch direction has to turn before the prediction is recomputed */
+	float AngleTolerance;
+
+	/** Updates the prediction for a projectile and returns the predicted polyline */
+	const TArray<FVector>& PredictProjectile(UWorld* World, const FTrajectoryLaunchParams& Launch, const AActor* IgnoredActor);
+
+	/** Predicts the straight flight of the gravity ball, stopping at the max distance or on the first blocking hit */
+	static void PredictGravityBall(UWorld* World, const FVector& Location, const FVector& Direction, float MaxDistance, const AActor* IgnoredActor, TArray<FVector>& OutPoints);
+
+	/** Last predicted polyline */
+	const TArray<FVector>& GetPoints() const { return Points; }
+
+	/** Forces the next prediction to start from scratch */
+	void Invalidate() { bIsValid = false; }
+
+private:
+	/** Simulates from step StartStep (whose state is already in Points/Velocities) to the end */
+	void Simulate(UWorld* World, const FTrajectoryLaunchParams& Launch, const AActor* IgnoredActor, int32 StartStep);
+
+	/**
+	 * Compares the fields of this frame with the ones used by the prediction.
+	 * @param OutFirstStep	first step of the path affected by the changes, Points.Num() if the path isn't affected
+	 * @returns true if any field changed beyond the tolerance
+	 */
+	bool FieldsChanged(int32& OutFirstStep) const;
+
+	/** Polyline of the prediction, one point per simulated step (fewer if it stopped early) */
+	TArray<FVector> Points;
+
+	/** Velocity at every point, so the simulation can resume from any step */
+	TArray<FVector> Velocities;
+
+	/** Fields used by the current prediction and the fields of this frame */
+	TArray<FGravityFieldState> CachedFields;
+	TArray<FGravityFieldState> Fields;
+
+	FTrajectoryLaunchParams CachedLaunch;
+	bool bIsValid;
+};
@@ -2,6 +2,17 @@
 
 
 #include "UProjectileMovementCompModified.h"
+#include "GravityMathConversions.h"
+#include "HAL/IConsoleManager.h"
+
+/** Substep counters of all the projectiles, split between homing and regular ones */
+static int64 NumProjectileTicks[2] = { 0, 0 };
+static int64 NumProjectileSubsteps[2] = { 0, 0 };
+
+static FAutoConsoleCommand ProjectileSubstepStatsCommand(
+	TEXT("fps.Projectiles.SubstepStats"),
+	TEXT("Logs the average substeps per projectile per frame since the last call, for homing and regular projectiles"),
+	FConsoleCommandDelegate::CreateStatic(&UUProjectileMovementCompModified::ReportSubstepStats));
 
 // Sets default values for this component's properties
 UUProjectileMovementCompModified::UUProjectileMovementCompModified()
@@ -10,7 +21,13 @@ UUProjectileMovementCompModified::UUProjectileMovementCompModified()
 	// off to improve performance if you don't need them.
 	PrimaryComponentTick.bCanEverTick = true;
 
-	// ...
+	bUseAdaptiveSubstepping = true;
+	AdaptiveStepTolerance = 0.1f;
+	MinAdaptiveTimeStep = 1.f / 240.f;
+	NumSubsteps = 0;
+
+	// close orbits around the ball need more substeps than the stock limit, the far ones only take one
+	MaxSimulationIterations = 16;
 }
 
 
@@ -27,18 +44,57 @@ void UUProjectileMovementCompModified::BeginPlay()
 // Called every frame
 void UUProjectileMovementCompModified::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
+	NumSubsteps = 0;
+	const bool bHoming = bIsHomingProjectile && HomingTargetComponent.IsValid();
+
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
-	// ...
+	// ticks that don't substep never ask for a time step, they take one step
+	NumProjectileTicks[bHoming ? 1 : 0]++;
+	NumProjectileSubsteps[bHoming ? 1 : 0] += FMath::Max(NumSubsteps, 1);
 }
 
-// Allow the projectile to track towards its homing target.
-FVector UUProjectileMovementCompModified::ComputeHomingAcceleration(const FVector& InVelocity, float DeltaTime) const
+float UUProjectileMovementCompModified::GetSimulationTimeStep(float RemainingTime, int32 Iterations) const
 {
-	FVector HomingAcceleration = ((HomingTargetComponent->GetComponentLocation() - UpdatedComponent->GetComponentLocation()).GetSafeNormal() * HomingAccelerationMagnitude);
+	NumSubsteps++;
 
-	//modification so that the homing mode can be used to repulse the projectile as well
-	HomingAcceleration = bIsHomingInverted ? -HomingAcceleration : HomingAcceleration;
+	if (!bUseAdaptiveSubstepping || !bIsHomingProjectile || !HomingTargetComponent.IsValid())
+	{
+		return Super::GetSimulationTimeStep(RemainingTime, Iterations);
+	}
+
+	// the last iteration allowed takes whatever is left
+	if (Iterations >= MaxSimulationIterations)
+	{
+		return FMath::Max(MIN_TICK_TIME, RemainingTime);
+	}
 
-	return HomingAcceleration;
+	// the homing acceleration has a constant magnitude and turns at speed / distance around the target,
+	// so a step is accurate while it covers a small part of the distance and changes the velocity by a small part of the speed
+	const float distance = FVector::Dist(HomingTargetComponent->GetComponentLocation(), UpdatedComponent->GetComponentLocation());
+	const float speed = FMath::Max(Velocity.Size(), KINDA_SMALL_NUMBER);
+	const float turnLimitedStep = distance / speed;
+	const float accelerationLimitedStep = HomingAccelerationMagnitude > KINDA_SMALL_NUMBER ? speed / HomingAccelerationMagnitude : BIG_NUMBER;
+	const float step = FMath::Max(MinAdaptiveTimeStep, AdaptiveStepTolerance * FMath::Min(turnLimitedStep, accelerationLimitedStep));
+
+	// split what's left in even steps instead of leaving a tiny one at the end
+	const int32 numSteps = FMath::Clamp(FMath::CeilToInt(RemainingTime / step), 1, MaxSimulationIterations - Iterations + 1);
+	return FMath::Max(MIN_TICK_TIME, RemainingTime / numSteps);
+}
+
+void UUProjectileMovementCompModified::ReportSubstepStats()
+{
+	UE_LOG(LogTemp, Display, TEXT("Projectile substeps per projectile per frame: homing %.2f (%lld ticks), regular %.2f (%lld ticks)"),
+		NumProjectileTicks[1] > 0 ? (double)NumProjectileSubsteps[1] / NumProjectileTicks[1] : 0.0, NumProjectileTicks[1],
+		NumProjectileTicks[0] > 0 ? (double)NumProjectileSubsteps[0] / NumProjectileTicks[0] : 0.0, NumProjectileTicks[0]);
+
+	NumProjectileTicks[0] = NumProjectileTicks[1] = 0;
+	NumProjectileSubsteps[0] = NumProjectileSubsteps[1] = 0;
 }
+
+// Allow the projectile to track towards its homing target.
+FVector UUProjectileMovementCompModified::ComputeHomingAcceleration(const FVector& InVelocity, float DeltaTime) const
+{
+	//modification so that the homing mode can be used to repulse the projectile as well
+	return ToFVector(GravityMath::HomingAcceleration(ToGravityVec(HomingTargetComponent->GetComponentLocation()), ToGravityVec(UpdatedComponent->GetComponentLocation()), HomingAccelerationMagnitude, bIsHomingInverted));
+}
\ No newline at end of file
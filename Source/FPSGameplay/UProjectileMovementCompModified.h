@@ -27,9 +27,31 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Homing)
 	bool bIsHomingInverted;
 
+	/** Picks the substep of homing projectiles from the distance to the target and the homing acceleration, instead of MaxSimulationTimeStep */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Homing)
+	bool bUseAdaptiveSubstepping;
+
+	/** Fraction of the distance to the target (and of the speed) a substep can cover. Lower is more accurate and more expensive */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Homing, meta = (ClampMin = "0.01", ClampMax = "1.0"))
+	float AdaptiveStepTolerance;
+
+	/** Shortest adaptive substep */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Homing, meta = (ClampMin = "0.0001"))
+	float MinAdaptiveTimeStep;
+
+	/** Logs the average substeps per projectile per frame since the last call and resets the counters */
+	static void ReportSubstepStats();
+
 	// Called every frame
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
 	/** Allow the projectile to track towards its homing target. Modified so that gravity ball can affect it*/
 	virtual FVector ComputeHomingAcceleration(const FVector& InVelocity, float DeltaTime) const override;
+
+	/** Adaptive substep for the homing projectiles: short close to the ball, one step per frame far from it */
+	virtual float GetSimulationTimeStep(float RemainingTime, int32 Iterations) const override;
+
+private:
+	/** Substeps taken in the current tick */
+	mutable int32 NumSubsteps;
 };
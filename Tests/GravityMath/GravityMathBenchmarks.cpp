@@ -0,0 +1,111 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GravityMath.h"
+#include "BarnesHut.h"
+#include <benchmark/benchmark.h>
+#include <random>
+#include <vector>
+
+using namespace GravityMath;
+
+/** Bodies spread over the gravity area of a ball */
+struct FBodies
+{
+	std::vector<FVec3> Positions;
+	std::vector<float> Masses;
+	std::vector<FVec3> Forces;
+
+	explicit FBodies(int32_t Count)
+	{
+		std::mt19937 random(42);
+		std::uniform_real_distribution<float> position(-1000.f, 1000.f);
+		std::uniform_real_distribution<float> mass(10.f, 200.f);
+		for (int32_t i = 0; i < Count; i++)
+		{
+			Positions.push_back(FVec3(position(random), position(random), position(random)));
+			Masses.push_back(mass(random));
+		}
+		Forces.resize(Count);
+	}
+};
+
+static void BM_AttractionForce(benchmark::State& State)
+{
+	FBodies bodies((int32_t)State.range(0));
+	const FVec3 ball(10.f, 20.f, 30.f);
+	for (auto _ : State)
+	{
+		for (size_t i = 0; i < bodies.Positions.size(); i++)
+		{
+			bodies.Forces[i] = AttractionForce(bodies.Positions[i], ball, 3.f, bodies.Masses[i]);
+		}
+		benchmark::DoNotOptimize(bodies.Forces.data());
+		benchmark::ClobberMemory();
+	}
+	State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+BENCHMARK(BM_AttractionForce)->Range(64, 4096);
+
+template<typename TFalloff, bool bRepel>
+static void BM_RadialForceKernel(benchmark::State& State, TFalloff Falloff)
+{
+	FBodies bodies((int32_t)State.range(0));
+	const FVec3 ball(10.f, 20.f, 30.f);
+	for (auto _ : State)
+	{
+		RadialForceKernel<TFalloff, bRepel>(bodies.Positions.data(), bodies.Masses.data(), (int32_t)bodies.Positions.size(), ball, 3.f, Falloff, bodies.Forces.data());
+		benchmark::DoNotOptimize(bodies.Forces.data());
+		benchmark::ClobberMemory();
+	}
+	State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+
+static const float CurveTable[] = { 0.f, 0.4f, 0.8f, 1.f, 0.9f, 0.7f, 0.4f, 0.2f };
+
+// BENCHMARK_CAPTURE can't take template arguments with commas, one wrapper per mode/falloff pair
+static void BM_RadialForceLinear(benchmark::State& State) { BM_RadialForceKernel<FLinearFalloff, false>(State, FLinearFalloff()); }
+static void BM_RadialForceLinearRepel(benchmark::State& State) { BM_RadialForceKernel<FLinearFalloff, true>(State, FLinearFalloff()); }
+static void BM_RadialForceConstant(benchmark::State& State) { BM_RadialForceKernel<FConstantFalloff, false>(State, FConstantFalloff{ 1000.f }); }
+static void BM_RadialForceInverseSquare(benchmark::State& State) { BM_RadialForceKernel<FInverseSquareFalloff, false>(State, FInverseSquareFalloff{ 1000.f, 50.f }); }
+static void BM_RadialForceTable(benchmark::State& State) { BM_RadialForceKernel<FTableFalloff, false>(State, FTableFalloff{ CurveTable, 8, 1000.f }); }
+BENCHMARK(BM_RadialForceLinear)->Range(64, 4096);
+BENCHMARK(BM_RadialForceLinearRepel)->Range(64, 4096);
+BENCHMARK(BM_RadialForceConstant)->Range(64, 4096);
+BENCHMARK(BM_RadialForceInverseSquare)->Range(64, 4096);
+BENCHMARK(BM_RadialForceTable)->Range(64, 4096);
+
+static void BM_HomingAcceleration(benchmark::State& State)
+{
+	FBodies bodies((int32_t)State.range(0));
+	const FVec3 target(10.f, 20.f, 30.f);
+	for (auto _ : State)
+	{
+		for (size_t i = 0; i < bodies.Positions.size(); i++)
+		{
+			bodies.Forces[i] = HomingAcceleration(target, bodies.Positions[i], 2000.f, (i & 1) != 0);
+		}
+		benchmark::DoNotOptimize(bodies.Forces.data());
+		benchmark::ClobberMemory();
+	}
+	State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+BENCHMARK(BM_HomingAcceleration)->Range(64, 4096);
+
+/** Tree build and force pass of the mutual attraction, with the opening angle in tenths as the second argument */
+static void BM_BarnesHut(benchmark::State& State)
+{
+	FBodies bodies((int32_t)State.range(0));
+	const float openingAngle = State.range(1) / 10.f;
+	FBarnesHutTree tree;
+	for (auto _ : State)
+	{
+		tree.Build(bodies.Positions.data(), bodies.Masses.data(), (int32_t)bodies.Positions.size());
+		tree.AccumulateForces(1.f, openingAngle, 10.f, bodies.Forces.data());
+		benchmark::DoNotOptimize(bodies.Forces.data());
+		benchmark::ClobberMemory();
+	}
+	State.SetItemsProcessed(State.iterations() * State.range(0));
+}
+BENCHMARK(BM_BarnesHut)->ArgsProduct({ { 64, 512, 4096 }, { 0, 5, 10 } });
+
+BENCHMARK_MAIN();
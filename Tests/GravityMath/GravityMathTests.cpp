@@ -0,0 +1,292 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#include "GravityMath.h"
+#include "BarnesHut.h"
+#include <gtest/gtest.h>
+#include <random>
+#include <vector>
+
+using namespace GravityMath;
+
+static void ExpectVecNear(const FVec3& Expected, const FVec3& Actual, float Tolerance)
+{
+	EXPECT_NEAR(Expected.X, Actual.X, Tolerance);
+	EXPECT_NEAR(Expected.Y, Actual.Y, Tolerance);
+	EXPECT_NEAR(Expected.Z, Actual.Z, Tolerance);
+}
+
+static float Size(const FVec3& V)
+{
+	return std::sqrt(SizeSquared(V));
+}
+
+/** Bodies spread over a cube, the same seed gives the same bodies */
+static void MakeBodies(int32_t Count, uint32_t Seed, std::vector<FVec3>& OutPositions, std::vector<float>& OutMasses)
+{
+	std::mt19937 random(Seed);
+	std::uniform_real_distribution<float> position(-1000.f, 1000.f);
+	std::uniform_real_distribution<float> mass(10.f, 200.f);
+	OutPositions.resize(Count);
+	OutMasses.resize(Count);
+	for (int32_t i = 0; i < Count; i++)
+	{
+		OutPositions[i] = FVec3(position(random), position(random), position(random));
+		OutMasses[i] = mass(random);
+	}
+}
+
+TEST(GravityMathTest, SafeNormalOfTinyVectorIsZero)
+{
+	ExpectVecNear(FVec3(), SafeNormal(FVec3(1.e-5f, 0.f, 0.f)), 0.f);
+	ExpectVecNear(FVec3(0.f, 1.f, 0.f), SafeNormal(FVec3(0.f, 25.f, 0.f)), 1.e-6f);
+}
+
+TEST(GravityMathTest, AttractionPullsTowardsTheBall)
+{
+	const FVec3 force = AttractionForce(FVec3(100.f, 0.f, 0.f), FVec3(), 2.f, 3.f);
+	ExpectVecNear(FVec3(-600.f, 0.f, 0.f), force, 1.e-3f);
+}
+
+TEST(GravityMathTest, RepulsionIsTheOppositeOfAttraction)
+{
+	const FVec3 body(10.f, -20.f, 30.f);
+	const FVec3 ball(-5.f, 5.f, 0.f);
+	ExpectVecNear(-AttractionForce(body, ball, 4.f, 2.f), RepulsionForce(body, ball, 4.f, 2.f), 1.e-3f);
+}
+
+TEST(GravityMathTest, HomingAccelerationHasTheGivenMagnitude)
+{
+	const FVec3 acceleration = HomingAcceleration(FVec3(0.f, 300.f, 400.f), FVec3(), 50.f, false);
+	ExpectVecNear(FVec3(0.f, 30.f, 40.f), acceleration, 1.e-4f);
+	EXPECT_NEAR(50.f, Size(acceleration), 1.e-4f);
+}
+
+TEST(GravityMathTest, InvertedHomingPointsAwayFromTheTarget)
+{
+	const FVec3 target(0.f, 300.f, 400.f);
+	ExpectVecNear(-HomingAcceleration(target, FVec3(), 50.f, false), HomingAcceleration(target, FVec3(), 50.f, true), 1.e-4f);
+}
+
+TEST(GravityMathTest, HomingOnTheTargetIsZero)
+{
+	ExpectVecNear(FVec3(), HomingAcceleration(FVec3(1.f, 2.f, 3.f), FVec3(1.f, 2.f, 3.f), 50.f, false), 0.f);
+}
+
+TEST(GravityMathFalloffTest, LinearIsOneEverywhere)
+{
+	const FLinearFalloff falloff;
+	EXPECT_EQ(1.f, falloff.Scale(0.f));
+	EXPECT_EQ(1.f, falloff.Scale(1.e6f));
+}
+
+TEST(GravityMathFalloffTest, ConstantMatchesLinearAtTheRim)
+{
+	const FConstantFalloff falloff{ 1000.f };
+	EXPECT_NEAR(1.f, falloff.Scale(1000.f * 1000.f), 1.e-6f);
+	EXPECT_NEAR(2.f, falloff.Scale(500.f * 500.f), 1.e-5f);
+	EXPECT_EQ(0.f, falloff.Scale(0.f));
+}
+
+TEST(GravityMathFalloffTest, ConstantGivesTheSameMagnitudeEverywhere)
+{
+	const FConstantFalloff falloff{ 1000.f };
+	const FVec3 ball;
+	for (float distance : { 50.f, 250.f, 999.f })
+	{
+		const FVec3 body(distance, 0.f, 0.f);
+		const FVec3 force = AttractionForce(body, ball, 1.f, 1.f) * falloff.Scale(SizeSquared(body - ball));
+		EXPECT_NEAR(1000.f, Size(force), 1.e-2f);
+	}
+}
+
+TEST(GravityMathFalloffTest, InverseSquareIsFiniteAndDecreasing)
+{
+	const FInverseSquareFalloff falloff{ 1000.f, 50.f };
+	float previousMagnitude = 1.e30f;
+	for (float distance : { 1.f, 10.f, 100.f, 500.f, 1000.f })
+	{
+		const float magnitude = distance * falloff.Scale(distance * distance);
+		EXPECT_TRUE(std::isfinite(magnitude));
+		if (distance >= 100.f)
+		{
+			EXPECT_LT(magnitude, previousMagnitude);
+		}
+		previousMagnitude = magnitude;
+	}
+	EXPECT_EQ(0.f, falloff.Scale(0.f));
+}
+
+TEST(GravityMathFalloffTest, InverseSquareMatchesTheUnsoftenedForceOutsideTheSoftening)
+{
+	// the softening only matters close to the center, further away the magnitude is Radius^3 / d^2
+	const FInverseSquareFalloff falloff{ 1000.f, 50.f };
+	for (float distance : { 500.f, 1000.f, 2000.f })
+	{
+		const float expected = 1000.f * 1000.f * 1000.f / (distance * distance);
+		EXPECT_NEAR(expected, distance * falloff.Scale(distance * distance), 0.01f * expected);
+	}
+}
+
+TEST(GravityMathFalloffTest, TableInterpolatesAndClamps)
+{
+	const float table[] = { 0.f, 1.f, 0.5f };
+	const FTableFalloff falloff{ table, 3, 1000.f };
+
+	// magnitude is Radius * Value, the scale divides it by the distance
+	EXPECT_NEAR(500.f, 250.f * falloff.Scale(250.f * 250.f), 1.e-2f);
+	EXPECT_NEAR(1000.f, 500.f * falloff.Scale(500.f * 500.f), 1.e-2f);
+	EXPECT_NEAR(750.f, 750.f * falloff.Scale(750.f * 750.f), 1.e-2f);
+	EXPECT_NEAR(500.f, 2000.f * falloff.Scale(2000.f * 2000.f), 1.e-2f);
+}
+
+TEST(GravityMathFalloffTest, EmptyTableIsZero)
+{
+	const FTableFalloff falloff{ nullptr, 0, 1000.f };
+	EXPECT_EQ(0.f, falloff.Scale(100.f));
+}
+
+TEST(GravityMathKernelTest, LinearKernelMatchesTheScalarForces)
+{
+	std::vector<FVec3> positions;
+	std::vector<float> masses;
+	MakeBodies(37, 1, positions, masses);
+	std::vector<FVec3> forces(positions.size());
+	const FVec3 ball(10.f, 20.f, 30.f);
+
+	RadialForceKernel<FLinearFalloff, false>(positions.data(), masses.data(), (int32_t)positions.size(), ball, 3.f, FLinearFalloff(), forces.data());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		ExpectVecNear(AttractionForce(positions[i], ball, 3.f, masses[i]), forces[i], 1.e-1f);
+	}
+
+	RadialForceKernel<FLinearFalloff, true>(positions.data(), masses.data(), (int32_t)positions.size(), ball, 3.f, FLinearFalloff(), forces.data());
+	for (size_t i = 0; i < positions.size(); i++)
+	{
+		ExpectVecNear(RepulsionForce(positions[i], ball, 3.f, masses[i]), forces[i], 1.e-1f);
+	}
+}
+
+TEST(GravityMathKernelTest, KernelAppliesTheFalloff)
+{
+	const FVec3 position(400.f, 0.f, 0.f);
+	const float mass = 2.f;
+	const FInverseSquareFalloff falloff{ 1000.f, 50.f };
+	FVec3 force;
+
+	RadialForceKernel<FInverseSquareFalloff, false>(&position, &mass, 1, FVec3(), 5.f, falloff, &force);
+	ExpectVecNear(AttractionForce(position, FVec3(), 5.f, mass) * falloff.Scale(SizeSquared(position)), force, 1.e-2f);
+}
+
+TEST(BarnesHutTest, EmptyTreeAddsNothing)
+{
+	FBarnesHutTree tree;
+	tree.Build(nullptr, nullptr, 0);
+	EXPECT_EQ(0, tree.GetNumNodes());
+	tree.AccumulateForces(1.f, 0.5f, 1.f, nullptr);
+}
+
+TEST(BarnesHutTest, TwoBodiesAttractEachOtherEqually)
+{
+	const FVec3 positions[] = { FVec3(-100.f, 0.f, 0.f), FVec3(100.f, 0.f, 0.f) };
+	const float masses[] = { 10.f, 10.f };
+	FVec3 forces[2];
+
+	FBarnesHutTree tree;
+	tree.Build(positions, masses, 2);
+	tree.AccumulateForces(1000.f, 0.5f, 0.f, forces);
+
+	EXPECT_GT(forces[0].X, 0.f);
+	ExpectVecNear(-forces[0], forces[1], 1.e-4f);
+	// G * m1 * m2 / d^2
+	EXPECT_NEAR(1000.f * 10.f * 10.f / (200.f * 200.f), forces[0].X, 1.e-4f);
+}
+
+TEST(BarnesHutTest, SofteningOnlyMattersCloseUp)
+{
+	// far outside the softening radius the pair follows the unsoftened G * m1 * m2 / d^2
+	const FVec3 positions[] = { FVec3(-1000.f, 0.f, 0.f), FVec3(1000.f, 0.f, 0.f) };
+	const float masses[] = { 10.f, 20.f };
+	FVec3 forces[2];
+
+	FBarnesHutTree tree;
+	tree.Build(positions, masses, 2);
+	tree.AccumulateForces(1000.f, 0.5f, 10.f, forces);
+
+	const float expected = 1000.f * 10.f * 20.f / (2000.f * 2000.f);
+	EXPECT_NEAR(expected, forces[0].X, 1.e-3f * expected);
+	EXPECT_NEAR(-expected, forces[1].X, 1.e-3f * expected);
+}
+
+TEST(BarnesHutTest, ZeroOpeningAngleIsTheExactSum)
+{
+	std::vector<FVec3> positions;
+	std::vector<float> masses;
+	MakeBodies(200, 2, positions, masses);
+	const int32_t count = (int32_t)positions.size();
+	const float softening = 10.f;
+
+	std::vector<FVec3> exact(count);
+	for (int32_t i = 0; i < count; i++)
+	{
+		for (int32_t j = 0; j < count; j++)
+		{
+			if (i != j)
+			{
+				const FVec3 offset = positions[j] - positions[i];
+				const float distanceSquared = SizeSquared(offset) + softening * softening;
+				exact[i] += offset * (masses[i] * masses[j] / (distanceSquared * std::sqrt(distanceSquared)));
+			}
+		}
+	}
+
+	std::vector<FVec3> forces(count);
+	FBarnesHutTree tree;
+	tree.Build(positions.data(), masses.data(), count);
+	tree.AccumulateForces(1.f, 0.f, softening, forces.data());
+
+	for (int32_t i = 0; i < count; i++)
+	{
+		ExpectVecNear(exact[i], forces[i], 1.e-3f * Size(exact[i]) + 1.e-6f);
+	}
+}
+
+TEST(BarnesHutTest, OpeningAngleStaysCloseToTheExactSum)
+{
+	std::vector<FVec3> positions;
+	std::vector<float> masses;
+	MakeBodies(500, 3, positions, masses);
+	const int32_t count = (int32_t)positions.size();
+
+	std::vector<FVec3> exact(count);
+	std::vector<FVec3> approximate(count);
+	FBarnesHutTree tree;
+	tree.Build(positions.data(), masses.data(), count);
+	tree.AccumulateForces(1.f, 0.f, 10.f, exact.data());
+	tree.AccumulateForces(1.f, 0.5f, 10.f, approximate.data());
+
+	double errorSum = 0.0;
+	for (int32_t i = 0; i < count; i++)
+	{
+		errorSum += Size(approximate[i] - exact[i]) / Size(exact[i]);
+	}
+	EXPECT_LT(errorSum / count, 0.02);
+}
+
+TEST(BarnesHutTest, BodiesInTheSameSpotStayFinite)
+{
+	std::vector<FVec3> positions(16, FVec3(5.f, 5.f, 5.f));
+	std::vector<float> masses(16, 1.f);
+	positions.push_back(FVec3(500.f, 0.f, 0.f));
+	masses.push_back(1.f);
+	std::vector<FVec3> forces(positions.size());
+
+	FBarnesHutTree tree;
+	tree.Build(positions.data(), masses.data(), (int32_t)positions.size());
+	tree.AccumulateForces(1.f, 0.5f, 1.f, forces.data());
+
+	for (const FVec3& force : forces)
+	{
+		EXPECT_TRUE(std::isfinite(force.X) && std::isfinite(force.Y) && std::isfinite(force.Z));
+	}
+	EXPECT_LT(forces.back().X, 0.f);
+}